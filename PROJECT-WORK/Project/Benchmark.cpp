@@ -0,0 +1,649 @@
+// Throughput benchmarks for the Smart Hospital Management System.
+// Build:  g++ -O2 -std=c++17 -pthread Benchmark.cpp -o Benchmark
+// Run:    Benchmark [rows] [heap|pooled]   (works in a scratch directory: bench_*.txt files;
+//         the second argument limits the allocator benchmark to one strategy)
+#define SHMS_NO_MAIN
+#include "Project Code.cpp"
+#include <chrono>
+
+using BenchClock = chrono::steady_clock;
+
+static double secondsSince(BenchClock::time_point t0) {
+    return chrono::duration<double>(BenchClock::now() - t0).count();
+}
+
+static void printRate(const string &label, double count, double secs, const string &unit) {
+    cout << "  " << setw(34) << left << label
+         << setw(14) << right << fixed << setprecision(0) << (secs > 0 ? count / secs : 0.0)
+         << " " << unit << "  (" << setprecision(3) << secs << " s)\n";
+}
+
+// --------------------------
+// Data generation
+// --------------------------
+static const char *FIRST_NAMES[] = {"Ali", "Ayesha", "Omar", "Muneeba", "Ghulam", "Jawahir", "Akbar", "Sara", "Bilal", "Hina"};
+static const char *LAST_NAMES[] = {"Khan", "Hassan", "Ali", "Arshad", "Hussain", "Deen", "Mushtaq", "Ahmed", "Iqbal", "Raza"};
+
+static Patient makePatient(int id) {
+    Patient p(id, string(FIRST_NAMES[id % 10]) + " " + LAST_NAMES[(id / 10) % 10], 18 + id % 60,
+              (id % 2) ? "Male" : "Female", "+92-300-" + to_string(1000000 + id), id % 3 == 0,
+              id % 3 == 0 ? "Statelife" : "", to_string(35201000000LL + id));
+    return p;
+}
+
+static void writePatientsFile(const string &fname, int rows) {
+    ofstream out(fname);
+    for (int i = 1; i <= rows; ++i) out << joinCSV(makePatient(i).toCSVRow()) << "\n";
+}
+
+// --------------------------
+// Load benchmarks
+// --------------------------
+// The loader as it was before the tokenizer: a character-at-a-time split
+// into fresh strings, stoi behind try/catch, and a record of plain strings.
+static vector<string> oldSplitCSV(const string &line) {
+    vector<string> out;
+    string cur;
+    bool inQuotes = false;
+    for (size_t i = 0; i < line.size(); ++i) {
+        char c = line[i];
+        if (c == '\"') {
+            inQuotes = !inQuotes;
+            continue;
+        }
+        if (c == ',' && !inQuotes) {
+            out.push_back(trim(cur));
+            cur.clear();
+        } else cur.push_back(c);
+    }
+    out.push_back(trim(cur));
+    return out;
+}
+
+static int oldToIntSafe(const string &s, int defaultVal = 0) {
+    try { return stoi(s); } catch (...) { return defaultVal; }
+}
+
+struct StringPatient {
+    int id = 0, age = 0;
+    string name, gender, contact, insuranceProvider, nationalId, medicalHistory;
+    bool insured = false;
+
+    static StringPatient fromCSV(const vector<string> &r) {
+        StringPatient p;
+        if (r.size() >= 1) p.id = oldToIntSafe(r[0], 0);
+        if (r.size() >= 2) p.name = r[1];
+        if (r.size() >= 3) p.age = oldToIntSafe(r[2], 0);
+        if (r.size() >= 4) p.gender = r[3];
+        if (r.size() >= 5) p.contact = r[4];
+        if (r.size() >= 6) p.insured = (r[5] == "1");
+        if (r.size() >= 7) p.insuranceProvider = r[6];
+        if (r.size() >= 8) p.nationalId = r[7];
+        if (r.size() >= 9) p.medicalHistory = r[8];
+        return p;
+    }
+};
+
+static void benchLoad(int rows) {
+    const string fname = "bench_patients.txt";
+    writePatientsFile(fname, rows);
+    cout << "Load " << rows << " patient rows\n";
+
+    // getline + trim + the old splitter + fromCSV, as the loaders used to
+    vector<StringPatient> old;
+    old.reserve(rows);
+    auto t0 = BenchClock::now();
+    {
+        ifstream in(fname);
+        string line;
+        while (getline(in, line)) {
+            if (trim(line).empty()) continue;
+            old.push_back(StringPatient::fromCSV(oldSplitCSV(line)));
+        }
+    }
+    printRate("getline + old splitCSV (baseline)", old.size(), secondsSince(t0), "rows/s");
+    old.clear(); old.shrink_to_fit();
+
+    vector<Patient> out;
+    out.reserve(rows);
+
+    // mapped loader, once with the scalar block scanner and once with the dispatched one
+    StructuralMaskFn best = structuralMask;
+    const char *bestName = structuralMaskName;
+    StructuralMaskFn kernels[] = {structuralMaskScalar, best};
+    string names[] = {"scalar", bestName};
+    for (int k = 0; k < 2; ++k) {
+        structuralMask = kernels[k];
+        out.clear();
+        t0 = BenchClock::now();
+        forEachCSVRow(fname, [&](const string_view *r, size_t n) { out.push_back(Patient::fromFields(r, n)); });
+        printRate("mapped, " + names[k] + " tokenizer", out.size(), secondsSince(t0), "rows/s");
+
+        // tokenizer alone, no record construction
+        size_t fields = 0;
+        MappedFile mf(fname);
+        t0 = BenchClock::now();
+        tokenizeCSV(mf.view(), [&](const string_view *, size_t n) { fields += n; });
+        printRate("  tokenize only, " + names[k], mf.view().size() / 1e6, secondsSince(t0), "MB/s");
+    }
+    structuralMask = best;
+
+    remove(fname.c_str());
+}
+
+// --------------------------
+// Allocator benchmarks
+// --------------------------
+// The per-record indexes the loaders build (appointments by owner, name
+// trigrams, phone keys), built and torn down on the global heap and on
+// their own pools; then journal rows split into fresh vector<string>s
+// versus a scratch arena reset per record. only = "heap" or "pooled" runs
+// just that strategy, e.g. under a profiler.
+static void benchAllocators(int rows, const string &only) {
+    cout << "Allocators, " << rows << " records\n";
+    vector<string> names, contacts;
+    names.reserve(rows);
+    contacts.reserve(rows);
+    for (int i = 1; i <= rows; ++i) {
+        Patient p = makePatient(i);
+        names.push_back(p.getName());
+        contacts.push_back(p.getContact());
+    }
+
+    for (bool pooled : {false, true}) {
+        string strategy = pooled ? "pooled" : "heap";
+        if (!only.empty() && only != strategy) continue;
+        auto t0 = BenchClock::now();
+        double buildSecs;
+        {
+            AppointmentIndex byPatient(pooled);
+            TrigramIndex nameIndex(pooled);
+            KeyIndex phones(normalizePhone, pooled);
+            for (int i = 0; i < rows; ++i) {
+                byPatient.add(i % 50000 + 1, Timestamp(1700000000 + (int64_t)i * 60), i + 1);
+                nameIndex.set(i + 1, names[i]);
+                phones.set(i + 1, contacts[i]);
+            }
+            buildSecs = secondsSince(t0);
+            t0 = BenchClock::now();
+        }
+        printRate("index build, " + strategy, rows, buildSecs, "records/s");
+        printRate("index teardown, " + strategy, rows, secondsSince(t0), "records/s");
+    }
+
+    vector<string> lines;
+    lines.reserve(rows);
+    for (int i = 1; i <= rows; ++i) lines.push_back("P," + joinCSV(makePatient(i).toCSVRow()));
+    size_t heapFields = 0, arenaFields = 0;
+    if (only.empty() || only == "heap") {
+        auto t0 = BenchClock::now();
+        for (auto &line : lines) heapFields += splitCSV(line.substr(2)).size();
+        printRate("journal split, heap", rows, secondsSince(t0), "rows/s");
+    }
+    if (only.empty() || only == "pooled") {
+        ScratchArena<8192> scratch;
+        auto t0 = BenchClock::now();
+        for (auto &line : lines) {
+            arenaFields += splitCSV(string_view(line).substr(2), scratch.get()).size();
+            scratch.reset();
+        }
+        printRate("journal split, scratch arena", rows, secondsSince(t0), "rows/s");
+    }
+    if (only.empty() && heapFields != arenaFields) cout << "  field count mismatch\n";
+}
+
+// --------------------------
+// Save benchmarks
+// --------------------------
+static size_t fileSize(const string &fname) {
+    ifstream in(fname, ios::binary | ios::ate);
+    return in ? (size_t)in.tellg() : 0;
+}
+
+static void benchSave(int rows) {
+    const string fname = "bench_save.txt";
+    vector<Patient> patients;
+    patients.reserve(rows);
+    for (int i = 1; i <= rows; ++i) patients.push_back(makePatient(i));
+    cout << "Save " << rows << " patient rows\n";
+
+    // toCSVRow vector + joinCSV string per row
+    auto t0 = BenchClock::now();
+    {
+        ofstream out(fname);
+        for (auto &p : patients) out << joinCSV(p.toCSVRow()) << "\n";
+    }
+    double secs = secondsSince(t0);
+    printRate("toCSVRow + joinCSV", fileSize(fname) / 1e6, secs, "MB/s");
+
+    // streaming serializer into one reusable buffer
+    t0 = BenchClock::now();
+    {
+        ofstream out(fname);
+        CsvWriter w(&out);
+        for (auto &p : patients) p.writeCSV(w);
+    }
+    secs = secondsSince(t0);
+    printRate("CsvWriter", fileSize(fname) / 1e6, secs, "MB/s");
+
+    remove(fname.c_str());
+}
+
+// --------------------------
+// Durable save benchmarks
+// --------------------------
+// clients threads each save their own small table and wait until it is on
+// disk, as concurrent sessions would
+static void benchDurableSaves(int clients, int savesPerClient) {
+    cout << "Durable saves, " << clients << " clients x " << savesPerClient << "\n";
+    auto rows = make_shared<vector<Patient>>();
+    for (int i = 1; i <= 200; ++i) rows->push_back(makePatient(i));
+
+    struct Mode { const char *label; bool durable; long long windowUs; };
+    Mode modes[] = {{"no sync", false, 0}, {"sync every save", true, 0}, {"group commit", true, GROUP_COMMIT_WINDOW.count()}};
+    for (auto &mode : modes) {
+        size_t commits;
+        auto t0 = BenchClock::now();
+        {
+            PersistenceWriter writer(mode.durable, chrono::microseconds(mode.windowUs));
+            vector<thread> threads;
+            for (int c = 0; c < clients; ++c) {
+                threads.emplace_back([&, c] {
+                    string fname = "bench_durable_" + to_string(c) + ".txt";
+                    for (int i = 0; i < savesPerClient; ++i) {
+                        uint64_t ticket = writer.writeFile(fname, [rows](ostream &out) {
+                            CsvWriter w(&out);
+                            for (auto &p : *rows) p.writeCSV(w);
+                        });
+                        writer.waitFor(ticket);
+                    }
+                });
+            }
+            for (auto &t : threads) t.join();
+            commits = writer.commitCount();
+        }
+        double secs = secondsSince(t0);
+        printRate(string(mode.label) + " (" + to_string(commits) + " commits)", (double)clients * savesPerClient, secs, "saves/s");
+    }
+    for (int c = 0; c < clients; ++c) remove(("bench_durable_" + to_string(c) + ".txt").c_str());
+}
+
+// --------------------------
+// Table benchmarks
+// --------------------------
+// the same patients in the old node map and in the slot map the database uses
+static void benchTables(int rows) {
+    cout << "Table scan and lookup over " << rows << " patients\n";
+    map<int, Patient> tree;
+    SlotMap<Patient> slots;
+    for (int i = 1; i <= rows; ++i) {
+        Patient p = makePatient(i);
+        tree[i] = p;
+        slots[i] = std::move(p);
+    }
+
+    const int rounds = 10;
+    long long ageSum = 0;
+    auto t0 = BenchClock::now();
+    for (int r = 0; r < rounds; ++r)
+        for (auto &kv : tree) ageSum += kv.second.getAge();
+    printRate("full scan, map", (double)rounds * rows, secondsSince(t0), "rows/s");
+    t0 = BenchClock::now();
+    for (int r = 0; r < rounds; ++r)
+        for (auto &kv : slots) ageSum -= kv.second.getAge();
+    printRate("full scan, slot map", (double)rounds * rows, secondsSince(t0), "rows/s");
+
+    // same pseudo-random ids for both
+    vector<int> ids(rows);
+    uint32_t x = 12345;
+    for (auto &id : ids) { x = x * 1664525u + 1013904223u; id = 1 + (int)(x % (uint32_t)rows); }
+    long long found = 0;
+    t0 = BenchClock::now();
+    for (int id : ids) { auto it = tree.find(id); if (it != tree.end()) found += it->second.getAge(); }
+    printRate("random lookup, map", rows, secondsSince(t0), "lookups/s");
+    t0 = BenchClock::now();
+    for (int id : ids) { auto it = slots.find(id); if (it != slots.end()) found -= it->second.getAge(); }
+    printRate("random lookup, slot map", rows, secondsSince(t0), "lookups/s");
+    if (ageSum != 0 || found != 0) cout << "  mismatch between map and slot map\n";
+}
+
+// --------------------------
+// Column store benchmarks
+// --------------------------
+// "insured patients aged 20-30 per provider" over the records and over
+// the column mirror
+static void benchColumns(int rows) {
+    cout << "Insured patients aged 20-30 per provider, " << rows << " patients\n";
+    static const char *PROVIDERS[] = {"Statelife", "Jubilee", "Adamjee", "EFU", "DemoCare"};
+    SlotMap<Patient> patients;
+    PatientColumns columns;
+    for (int i = 1; i <= rows; ++i) {
+        Patient p = makePatient(i);
+        if (p.isInsured()) p.setInsuranceProvider(PROVIDERS[(i / 3) % 5]);
+        columns.set(p);
+        patients[i] = std::move(p);
+    }
+
+    const int rounds = 20;
+    map<string, uint64_t> fromRows, fromColumns;
+    auto t0 = BenchClock::now();
+    for (int r = 0; r < rounds; ++r)
+        for (auto &kv : patients) {
+            const Patient &p = kv.second;
+            if (p.isInsured() && p.getAge() >= 20 && p.getAge() <= 30) fromRows[p.getInsuranceProvider()]++;
+        }
+    printRate("row scan", (double)rounds * rows, secondsSince(t0), "rows/s");
+
+    t0 = BenchClock::now();
+    for (int r = 0; r < rounds; ++r)
+        for (auto &kv : columns.insuredByProvider(20, 30)) fromColumns[kv.first] += kv.second;
+    double secs = secondsSince(t0);
+    printRate("column kernel", (double)rounds * rows, secs, "rows/s");
+    // age (4 bytes), insured (1) and provider code (4) per row
+    cout << "  column bytes read: " << fixed << setprecision(2) << 9.0 * rounds * rows / secs / 1e9 << " GB/s\n";
+    if (fromRows != fromColumns) cout << "  mismatch between row scan and columns\n";
+}
+
+// --------------------------
+// Interning benchmarks
+// --------------------------
+static void benchInterning(int rows) {
+    cout << "Gender compares over " << rows << " rows\n";
+    static const char *SPELLINGS[] = {"Male", "male", "M", "Female", "F", "female"};
+    vector<string> strings;
+    vector<Symbol> symbols;
+    strings.reserve(rows);
+    symbols.reserve(rows);
+    auto t0 = BenchClock::now();
+    for (int i = 0; i < rows; ++i) symbols.push_back(SPELLINGS[i % 6]);
+    printRate("intern", rows, secondsSince(t0), "values/s");
+    for (int i = 0; i < rows; ++i) strings.push_back(SPELLINGS[i % 6]);
+
+    // what "is this patient male" costs with raw spellings vs one integer compare
+    const int rounds = 20;
+    size_t byString = 0, bySymbol = 0;
+    t0 = BenchClock::now();
+    for (int r = 0; r < rounds; ++r)
+        for (auto &s : strings) byString += s == "Male" || s == "male" || s == "M";
+    printRate("string compares", (double)rounds * rows, secondsSince(t0), "rows/s");
+    Symbol male("Male");
+    t0 = BenchClock::now();
+    for (int r = 0; r < rounds; ++r)
+        for (Symbol s : symbols) bySymbol += s == male;
+    printRate("symbol compares", (double)rounds * rows, secondsSince(t0), "rows/s");
+    cout << "  field size: string " << sizeof(string) << " bytes (+ heap for long values), symbol " << sizeof(Symbol)
+         << " bytes; sizeof(Patient) now " << sizeof(Patient) << "\n";
+    if (byString != bySymbol) cout << "  mismatch: " << byString << " vs " << bySymbol << "\n";
+}
+
+// --------------------------
+// Billing benchmarks
+// --------------------------
+// The old bill: description strings and double amounts, re-summed on every
+// total() call.
+struct DoubleBill {
+    vector<pair<string, double>> items;
+    bool insured = false;
+    double coveragePercent = 0;
+    double total() const {
+        double b = 0;
+        for (auto &it : items) b += it.second;
+        return insured ? b * (1.0 - coveragePercent / 100.0) : b;
+    }
+};
+
+static void benchBilling(int rows) {
+    cout << "Revenue over " << rows << " bills, 3 items each\n";
+    static const char *ITEMS[] = {"Consultation", "X-ray", "MRI", "Medicine", "CT scan"};
+    vector<DoubleBill> oldBills(rows);
+    vector<Bill> bills;
+    bills.reserve(rows);
+    BillColumns columns;
+    auto t0 = BenchClock::now();
+    for (int i = 0; i < rows; ++i) {
+        Bill b(i + 1, i % 1000 + 1, i % 3 == 0, 40.0);
+        for (int k = 0; k < 3; ++k) b.addItem(ITEMS[(i + k) % 5], Money::fromMinor(10000 + (i * 7 + k) % 99999));
+        columns.set(b);
+        bills.push_back(std::move(b));
+    }
+    printRate("build bills + columns", rows, secondsSince(t0), "bills/s");
+    for (int i = 0; i < rows; ++i) {
+        oldBills[i].insured = i % 3 == 0;
+        oldBills[i].coveragePercent = 40.0;
+        for (int k = 0; k < 3; ++k) oldBills[i].items.push_back({ITEMS[(i + k) % 5], (10000 + (i * 7 + k) % 99999) / 100.0});
+    }
+
+    const int rounds = 20;
+    double fromDoubles = 0;
+    t0 = BenchClock::now();
+    for (int r = 0; r < rounds; ++r) {
+        double sum = 0;
+        for (auto &b : oldBills) sum += b.total();
+        fromDoubles = sum;
+    }
+    printRate("double re-sum per bill", (double)rounds * rows, secondsSince(t0), "bills/s");
+
+    Money fromTotals;
+    t0 = BenchClock::now();
+    for (int r = 0; r < rounds; ++r) {
+        Money sum;
+        for (auto &b : bills) sum += b.total();
+        fromTotals = sum;
+    }
+    printRate("running subtotals", (double)rounds * rows, secondsSince(t0), "bills/s");
+
+    Money fromColumns;
+    t0 = BenchClock::now();
+    for (int r = 0; r < rounds; ++r) fromColumns = columns.revenue();
+    double secs = secondsSince(t0);
+    printRate("totals column", (double)rounds * rows, secs, "bills/s");
+    cout << "  column bytes read: " << fixed << setprecision(2) << 8.0 * rounds * rows / secs / 1e9 << " GB/s\n";
+    cout << "  revenue " << fromColumns << " (doubles: " << fixed << setprecision(2) << fromDoubles << ")\n";
+    if (fromColumns != fromTotals) cout << "  mismatch between subtotals and column\n";
+}
+
+// --------------------------
+// Medical history benchmarks
+// --------------------------
+// The old layout kept history as one string inside Patient, so every
+// append that reached the disk rewrote the whole row, history included.
+static void benchHistory(int entries) {
+    cout << "Medical history, " << entries << " entries for one patient\n";
+    Patient p = makePatient(1);
+    string text;
+    size_t written = 0;
+    auto t0 = BenchClock::now();
+    for (int i = 0; i < entries; ++i) {
+        if (!text.empty()) text += "\n";
+        text += "Checkup " + to_string(i) + ": blood pressure normal";
+        CsvWriter w;
+        w.field(p.getId()).field(p.getName()).field(text);
+        w.endRow();
+        written += w.str().size();
+    }
+    printRate("string column (row rewritten)", entries, secondsSince(t0), "appends/s");
+    cout << "  bytes written: " << written << "\n";
+
+    HistoryLog log;
+    CsvWriter line;
+    written = 0;
+    Timestamp at = Timestamp::now();
+    t0 = BenchClock::now();
+    for (int i = 0; i < entries; ++i) {
+        HistoryEntry e{at, "Checkup " + to_string(i) + ": blood pressure normal"};
+        line.clear();
+        e.writeCSV(line, p.getId());
+        written += line.str().size();
+        log.append(p.getId(), std::move(e));
+    }
+    printRate("chunked log (one line appended)", entries, secondsSince(t0), "appends/s");
+    cout << "  bytes written: " << written << "\n";
+
+    const int pages = 100000;
+    size_t seen = 0;
+    t0 = BenchClock::now();
+    for (int i = 0; i < pages; ++i) seen += log.recent(p.getId(), (size_t)(i % 10) * 10, 10).size();
+    printRate("newest-10 pages", pages, secondsSince(t0), "pages/s");
+    if (seen != (size_t)pages * 10) cout << "  short pages: " << seen << "\n";
+}
+
+// --------------------------
+// Login benchmarks
+// --------------------------
+static void benchLogins(int accounts) {
+    cout << "Logins against " << accounts << " accounts\n";
+    map<string, User> tree;
+    UserTable table;
+    for (int i = 0; i < accounts; ++i) {
+        User u{"user" + to_string(i), "Patient", "pw" + to_string(i * 7919), i};
+        tree[u.username] = u;
+        table[u.username] = u;
+    }
+
+    // every eighth attempt has a wrong password
+    const int logins = 1000000;
+    vector<pair<string, string>> attempts;
+    attempts.reserve(logins);
+    uint32_t x = 777;
+    for (int i = 0; i < logins; ++i) {
+        x = x * 1664525u + 1013904223u;
+        int id = (int)(x % (uint32_t)accounts);
+        attempts.push_back({"user" + to_string(id), "pw" + to_string(i % 8 ? id * 7919 : id)});
+    }
+
+    // the old authenticate: tree lookup, then a copy of the whole User
+    size_t treeOk = 0, tableOk = 0;
+    auto t0 = BenchClock::now();
+    for (auto &a : attempts) {
+        auto it = tree.find(a.first);
+        if (it == tree.end() || it->second.password != a.second) continue;
+        User out = it->second;
+        treeOk += out.linkedId >= 0;
+    }
+    printRate("map + copy", logins, secondsSince(t0), "logins/s");
+
+    t0 = BenchClock::now();
+    for (auto &a : attempts) {
+        uint32_t id = table.find(a.first);
+        Session s = id != UserTable::NONE && table.at(id).password == a.second ? Session{id} : Session();
+        tableOk += (bool)s;
+    }
+    printRate("flat hash, session handle", logins, secondsSince(t0), "logins/s");
+    if (treeOk != tableOk) cout << "  mismatch: " << treeOk << " vs " << tableOk << " successful logins\n";
+}
+
+// --------------------------
+// Name search benchmarks
+// --------------------------
+static const char *SYLLABLES[] = {"ka", "ri", "mo", "sa", "na", "di", "lu", "be", "to", "fa", "zi", "ha", "qu", "ne", "ro", "ya"};
+
+// first + last + a made-up third name, so names are not all alike
+static string makeName(int id) {
+    string extra;
+    for (int k = 0, v = id; k < 3; ++k, v /= 16) extra += SYLLABLES[v % 16];
+    extra[0] = (char)toupper((unsigned char)extra[0]);
+    return string(FIRST_NAMES[id % 10]) + " " + LAST_NAMES[(id / 10) % 10] + " " + extra;
+}
+
+static void benchNameSearch(int rows) {
+    cout << "Name search over " << rows << " patients\n";
+    map<int, Patient> patients;
+    for (int i = 1; i <= rows; ++i) {
+        Patient p = makePatient(i);
+        p.setName(makeName(i));
+        patients[i] = p;
+    }
+
+    auto t0 = BenchClock::now();
+    TrigramIndex index;
+    for (auto &kv : patients) index.set(kv.first, kv.second.getName());
+    printRate("build trigram index", rows, secondsSince(t0), "names/s");
+
+    const char *queries[] = {"Hassan", "kirosa", "Ayesha Ali", "mola", "Omar Raza Ne"};
+    const int rounds = 20;
+    size_t scanHits = 0, indexHits = 0;
+
+    // the old search: case-sensitive find over every patient, copying each hit
+    t0 = BenchClock::now();
+    for (int r = 0; r < rounds; ++r)
+        for (auto q : queries) {
+            vector<Patient> out;
+            for (auto &kv : patients) if (kv.second.getName().find(q) != string::npos) out.push_back(kv.second);
+            scanHits += out.size();
+        }
+    printRate("scan + copy", rounds * 5.0, secondsSince(t0), "queries/s");
+
+    t0 = BenchClock::now();
+    for (int r = 0; r < rounds; ++r)
+        for (auto q : queries) indexHits += index.search(q).size();
+    printRate("trigram index, substring", rounds * 5.0, secondsSince(t0), "queries/s");
+
+    t0 = BenchClock::now();
+    size_t prefixHits = 0;
+    for (int r = 0; r < rounds; ++r)
+        for (auto q : queries) prefixHits += index.search(q, TrigramIndex::PREFIX, 20).size();
+    printRate("trigram index, prefix top 20", rounds * 5.0, secondsSince(t0), "queries/s");
+    cout << "  hits per round: scan " << scanHits / rounds << ", index " << indexHits / rounds
+         << " (case-insensitive), prefix " << prefixHits / rounds << "\n";
+}
+
+// --------------------------
+// Duplicate detection benchmark
+// --------------------------
+// Names are a common first and last name plus a random middle word, so
+// blocks hold the people who share a first and last name, an age and a
+// middle name that sounds alike. Every 20th record copies an earlier one
+// with a changed case or vowel, so the expected pairs are known.
+static void benchDedup(int rows) {
+    cout << "Duplicate scan over " << rows << " records\n";
+    vector<DedupRecord> records;
+    records.reserve(rows);
+    set<pair<int, int>> planted; // (original id, copy id)
+    uint32_t x = 99;
+    for (int i = 1; i <= rows; ++i) {
+        if (i % 20 == 0) {
+            x = x * 1664525u + 1013904223u;
+            DedupRecord copy = records[x % records.size()];
+            planted.insert({copy.id, i});
+            copy.id = i;
+            size_t at = copy.name.find_first_of("aeiou", (size_t)i % copy.name.size());
+            if (at != string::npos && i % 40 == 0) copy.name[at] = at % 2 ? 'e' : 'o';
+            else copy.name[0] = (char)tolower((unsigned char)copy.name[0]);
+            records.push_back(copy);
+            continue;
+        }
+        string middle;
+        x = x * 1664525u + 1013904223u;
+        for (uint32_t k = 0, len = 5 + (x >> 28) % 4, v = x; k < len; ++k, v = v * 1103515245u + 12345u)
+            middle += (char)((k ? 'a' : 'A') + (v >> 16) % 26);
+        records.push_back({i, string(FIRST_NAMES[i % 10]) + " " + middle + " " + LAST_NAMES[(i / 10) % 10], 18 + i % 60});
+    }
+
+    auto t0 = BenchClock::now();
+    auto pairs = findMergeCandidates(records);
+    double secs = secondsSince(t0);
+    printRate("block + bit-parallel distance", rows, secs, "records/s");
+    size_t found = 0;
+    for (auto &c : pairs) found += planted.count({c.keepId, c.duplicateId});
+    cout << "  " << pairs.size() << " candidate pairs; " << found << " of " << planted.size()
+         << " planted copies found\n";
+}
+
+int main(int argc, char **argv) {
+    int rows = argc > 1 ? atoi(argv[1]) : 1000000;
+    if (rows <= 0) rows = 1000000;
+    string allocator = argc > 2 ? argv[2] : "";
+    benchLoad(rows);
+    benchAllocators(rows, allocator);
+    benchSave(rows);
+    benchDurableSaves(8, 100);
+    benchTables(rows);
+    benchColumns(rows);
+    benchBilling(rows);
+    benchInterning(rows);
+    benchHistory(min(rows, 5000)); // the string baseline is quadratic
+    benchLogins(rows);
+    benchNameSearch(rows);
+    benchDedup(rows);
+    return 0;
+}
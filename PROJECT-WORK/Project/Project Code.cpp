@@ -3,18 +3,47 @@
 //cout<<"        ===============================================================    "<<endl;
 #include <iostream>
 #include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <charconv>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <iomanip>
 #include <map>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <numeric>
+#include <queue>
+#include <set>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <thread>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 #include <windows.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHMS_X86_SIMD 1
+#include <immintrin.h>
+#endif
 using namespace std;
 
 // --------------------------
@@ -27,6 +56,13 @@ static const string APPOINTMENTS_FILE = "appointments.txt";
 static const string BILLS_FILE = "bills.txt";
 static const string MEDICINES_FILE = "medicines.txt";
 static const string USERS_FILE = "users.txt"; // username,role,password,linkedId
+static const string HISTORY_FILE = "history.txt"; // patientId,time,text (append-only, oldest first)
+static const string JOURNAL_FILE = "journal.txt"; // op,<row> (one record per mutation)
+static const size_t JOURNAL_COMPACT_THRESHOLD = 256; // records before base files are rewritten
+static const string SNAPSHOT_FILE = "shms.snap"; // binary copy of all tables, written on shutdown
+static const bool SNAPSHOT_ENABLED = true;
+static const bool LAZY_HISTORY = true; // parse bills/appointments rows only when a session needs them
+static const bool POOLED_INDEXES = true; // lookup indexes and history draw nodes from their own pools
 
 
 
@@ -64,22 +100,186 @@ inline string trim(const string &s) {
     return s.substr(a, b - a + 1);
 }
 
-inline vector<string> splitCSV(const string &line) {
-    vector<string> out;
-    string cur;
-    bool inQuotes = false;
-    for (size_t i = 0; i < line.size(); ++i) {
-        char c = line[i];
-        if (c == '\"') {
-            inQuotes = !inQuotes;
-            continue;
+inline string_view trimView(string_view s) {
+    size_t a = s.find_first_not_of(" \t\r\n");
+    if (a == string_view::npos) return string_view();
+    size_t b = s.find_last_not_of(" \t\r\n");
+    return s.substr(a, b - a + 1);
+}
+
+// --------------------------
+// Vectorized CSV tokenizer
+// --------------------------
+// Only '"', ',' and '\n' change tokenizer state. Each 64-byte block is
+// reduced to a bitmask of those bytes (AVX2, SSE4.2 or scalar, picked once
+// at startup) and the tokenizer jumps from set bit to set bit.
+static const size_t CSV_MAX_FIELDS = 16; // fields kept on the stack; widest row is patients.txt (8 fields, 9 in older files)
+
+typedef uint64_t (*StructuralMaskFn)(const char *p);
+
+static uint64_t structuralMaskScalar(const char *p) {
+    uint64_t m = 0;
+    for (int i = 0; i < 64; ++i) {
+        char c = p[i];
+        if (c == '\"' || c == ',' || c == '\n') m |= (uint64_t)1 << i;
+    }
+    return m;
+}
+
+#ifdef SHMS_X86_SIMD
+__attribute__((target("sse4.2")))
+static uint64_t structuralMaskSSE42(const char *p) {
+    const __m128i set = _mm_setr_epi8('\"', ',', '\n', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    uint64_t m = 0;
+    for (int i = 0; i < 4; ++i) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(p + 16 * i));
+        __m128i hits = _mm_cmpestrm(set, 3, block, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_BIT_MASK);
+        m |= (uint64_t)(uint16_t)_mm_cvtsi128_si32(hits) << (16 * i);
+    }
+    return m;
+}
+
+__attribute__((target("avx2")))
+static uint64_t structuralMaskAVX2(const char *p) {
+    const __m256i q = _mm256_set1_epi8('\"'), c = _mm256_set1_epi8(','), nl = _mm256_set1_epi8('\n');
+    __m256i lo = _mm256_loadu_si256((const __m256i*)p);
+    __m256i hi = _mm256_loadu_si256((const __m256i*)(p + 32));
+    __m256i hitsLo = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(lo, q), _mm256_cmpeq_epi8(lo, c)), _mm256_cmpeq_epi8(lo, nl));
+    __m256i hitsHi = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(hi, q), _mm256_cmpeq_epi8(hi, c)), _mm256_cmpeq_epi8(hi, nl));
+    return ((uint64_t)(uint32_t)_mm256_movemask_epi8(hitsHi) << 32) | (uint32_t)_mm256_movemask_epi8(hitsLo);
+}
+#endif
+
+static const char *structuralMaskName = "scalar";
+
+static StructuralMaskFn pickStructuralMask() {
+#ifdef SHMS_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) { structuralMaskName = "avx2"; return structuralMaskAVX2; }
+    if (__builtin_cpu_supports("sse4.2")) { structuralMaskName = "sse4.2"; return structuralMaskSSE42; }
+#endif
+    return structuralMaskScalar;
+}
+
+static StructuralMaskFn structuralMask = pickStructuralMask();
+
+inline int lowestBit(uint64_t m) {
+#ifdef __GNUC__
+    return __builtin_ctzll(m);
+#else
+    int i = 0;
+    while (!(m & 1)) { m >>= 1; ++i; }
+    return i;
+#endif
+}
+
+// Quotes are dropped, fields are trimmed and blank lines are skipped. ""
+// inside quotes is a literal quote, the escape joinCSV writes (the old
+// per-character splitCSV toggled on every quote and lost it). Fields that
+// need unescaping are copied into a scratch buffer; all views are only
+// valid inside onRow. A row wider than CSV_MAX_FIELDS moves the field
+// arrays to the heap, it is not cut.
+// onRow(fields, count, rowText) also gets the raw text of the line.
+template <typename F>
+void tokenizeCSVRows(string_view data, F onRow) {
+    static const size_t NOT_ESCAPED = (size_t)-1;
+    string_view fixedFields[CSV_MAX_FIELDS];
+    pair<size_t,size_t> fixedEsc[CSV_MAX_FIELDS]; // (offset,length) in scratch, or NOT_ESCAPED
+    vector<string_view> wideFields;
+    vector<pair<size_t,size_t>> wideEsc;
+    string_view *fields = fixedFields;
+    pair<size_t,size_t> *esc = fixedEsc;
+    size_t capacity = CSV_MAX_FIELDS;
+    string scratch;
+    size_t n = 0, fieldStart = 0, rowStart = 0;
+    bool inQuotes = false, quoted = false;
+    const char *base = data.data();
+
+    auto endField = [&](size_t end) {
+        if (n == capacity) {
+            if (fields == fixedFields) {
+                wideFields.assign(fixedFields, fixedFields + n);
+                wideEsc.assign(fixedEsc, fixedEsc + n);
+            }
+            capacity *= 2;
+            wideFields.resize(capacity);
+            wideEsc.resize(capacity);
+            fields = wideFields.data();
+            esc = wideEsc.data();
         }
-        if (c == ',' && !inQuotes) {
-            out.push_back(trim(cur));
-            cur.clear();
-        } else cur.push_back(c);
+        esc[n].first = NOT_ESCAPED;
+        string_view t = trimView(string_view(base + fieldStart, end - fieldStart));
+        if (!quoted) fields[n] = t;
+        else if (t.size() >= 2 && t.front() == '\"' && t.back() == '\"'
+                 && t.substr(1, t.size() - 2).find('\"') == string_view::npos) {
+            fields[n] = trimView(t.substr(1, t.size() - 2)); // plain "..." field
+        } else {
+            size_t from = scratch.size();
+            bool q = false;
+            for (size_t k = 0; k < t.size(); ++k) {
+                char c = t[k];
+                if (c != '\"') scratch.push_back(c);
+                else if (q && k + 1 < t.size() && t[k + 1] == '\"') { scratch.push_back('\"'); ++k; }
+                else q = !q;
+            }
+            string_view u = trimView(string_view(scratch).substr(from));
+            esc[n] = {u.empty() ? from : (size_t)(u.data() - scratch.data()), u.size()};
+        }
+        ++n;
+    };
+    auto endRow = [&](size_t end) {
+        if (!trimView(string_view(base + rowStart, end - rowStart)).empty()) {
+            for (size_t i = 0; i < n; ++i)
+                if (esc[i].first != NOT_ESCAPED) fields[i] = string_view(scratch.data() + esc[i].first, esc[i].second);
+            onRow(fields, n, string_view(base + rowStart, end - rowStart));
+        }
+        n = 0; scratch.clear(); inQuotes = false;
+    };
+    auto onStructural = [&](size_t pos) {
+        char c = base[pos];
+        if (c == '\"') { inQuotes = !inQuotes; quoted = true; }
+        else if (c == ',') {
+            if (!inQuotes) { endField(pos); fieldStart = pos + 1; quoted = false; }
+        } else {
+            endField(pos); endRow(pos);
+            fieldStart = rowStart = pos + 1; quoted = false;
+        }
+    };
+
+    size_t i = 0;
+    for (; i + 64 <= data.size(); i += 64) {
+        for (uint64_t m = structuralMask(base + i); m; m &= m - 1) onStructural(i + lowestBit(m));
+    }
+    if (i < data.size()) {
+        char tail[64];
+        memset(tail, ' ', sizeof(tail));
+        memcpy(tail, base + i, data.size() - i);
+        for (uint64_t m = structuralMask(tail); m; m &= m - 1) onStructural(i + lowestBit(m));
     }
-    out.push_back(trim(cur));
+    if (rowStart < data.size()) { endField(data.size()); endRow(data.size()); }
+}
+
+// onRow(fields, count)
+template <typename F>
+void tokenizeCSV(string_view data, F onRow) {
+    tokenizeCSVRows(data, [&](const string_view *f, size_t n, string_view) { onRow(f, n); });
+}
+
+inline vector<string> splitCSV(const string &line) {
+    vector<string> out;
+    tokenizeCSV(line, [&](const string_view *f, size_t n) { out.assign(f, f + n); });
+    if (out.empty()) out.push_back(""); // blank line: one empty field
+    return out;
+}
+
+// same split, with the row and its fields allocated from mr (load scratch)
+inline pmr::vector<pmr::string> splitCSV(string_view line, pmr::memory_resource *mr) {
+    pmr::vector<pmr::string> out(mr);
+    tokenizeCSV(line, [&](const string_view *f, size_t n) {
+        out.reserve(n);
+        for (size_t i = 0; i < n; ++i) out.emplace_back(f[i]);
+    });
+    if (out.empty()) out.emplace_back(); // blank line: one empty field
     return out;
 }
 
@@ -101,40 +301,547 @@ inline string joinCSV(const vector<string> &parts) {
     return out;
 }
 
+// --------------------------
+// Streaming CSV output
+// --------------------------
+// Rows are formatted straight into one reusable buffer that is handed to
+// the stream in large blocks. Numbers go through to_chars, and a field is
+// quoted in place after it is written, with joinCSV's rule (quote when it
+// holds ',' or ' ', double any '"' inside).
+class CsvWriter {
+private:
+    string buf;
+    ostream *out;
+    size_t flushAt;
+    bool rowOpen = false;
+
+    void separator() {
+        if (rowOpen) buf.push_back(',');
+        rowOpen = true;
+    }
+    template <typename... Args>
+    void appendChars(Args... args) {
+        char tmp[64];
+        auto r = to_chars(tmp, tmp + sizeof(tmp), args...);
+        buf.append(tmp, r.ptr);
+    }
+    void appendDouble(double v, bool fixed6) {
+#if defined(__cpp_lib_to_chars)
+        if (fixed6) appendChars(v, chars_format::fixed, 6); // same text as to_string(double)
+        else appendChars(v, chars_format::general, 6);      // same text as ostream << double
+#else
+        char tmp[64];
+        int n = snprintf(tmp, sizeof(tmp), fixed6 ? "%f" : "%g", v);
+        buf.append(tmp, n > 0 ? (size_t)n : 0);
+#endif
+    }
+public:
+    explicit CsvWriter(ostream *out_ = nullptr, size_t flushAt_ = 1 << 20) : out(out_), flushAt(flushAt_) {
+        buf.reserve(flushAt + 4096);
+    }
+    ~CsvWriter() { flush(); }
+    CsvWriter(const CsvWriter&) = delete;
+    CsvWriter& operator=(const CsvWriter&) = delete;
+
+    void flush() {
+        if (out && !buf.empty()) { out->write(buf.data(), (streamsize)buf.size()); buf.clear(); }
+    }
+    // for writers without a stream (journal lines)
+    const string& str() const { return buf; }
+    void clear() { buf.clear(); rowOpen = false; }
+
+    CsvWriter& field(string_view s) { size_t start = beginField(); buf.append(s.data(), s.size()); endField(start); return *this; }
+    CsvWriter& field(const string &s) { return field(string_view(s)); }
+    CsvWriter& field(const char *s) { return field(string_view(s)); }
+    CsvWriter& field(int v) { separator(); appendChars(v); return *this; }
+    CsvWriter& field(long long v) { separator(); appendChars(v); return *this; }
+    CsvWriter& field(double v) { separator(); appendDouble(v, true); return *this; }
+    CsvWriter& field(bool v) { separator(); buf.push_back(v ? '1' : '0'); return *this; }
+
+    // composite fields: beginField, any number of part() calls, endField
+    size_t beginField() { separator(); return buf.size(); }
+    CsvWriter& part(string_view s) { buf.append(s.data(), s.size()); return *this; }
+    CsvWriter& part(char c) { buf.push_back(c); return *this; }
+    CsvWriter& part(double v) { appendDouble(v, false); return *this; }
+    void endField(size_t start) {
+        size_t end = buf.size(), quotes = 0;
+        bool needQuotes = false;
+        for (size_t i = start; i < end; ++i) {
+            char c = buf[i];
+            if (c == ',' || c == ' ') needQuotes = true;
+            else if (c == '\"') ++quotes;
+        }
+        if (!needQuotes) return;
+        // shift right from the back, doubling quotes on the way
+        buf.resize(end + 2 + quotes);
+        size_t w = buf.size();
+        buf[--w] = '\"';
+        for (size_t i = end; i-- > start; ) {
+            char c = buf[i];
+            buf[--w] = c;
+            if (c == '\"') buf[--w] = '\"';
+        }
+        buf[--w] = '\"';
+    }
+
+    void endRow() {
+        buf.push_back('\n');
+        rowOpen = false;
+        if (out && buf.size() >= flushAt) flush();
+    }
+};
+
+
+// --------------------------
+// Timestamps
+// --------------------------
+// Seconds since 1970-01-01 00:00 of the clinic's wall clock (no time zone
+// involved). Text is parsed once when a record is read and produced only
+// for the files and the screen; everything in between compares integers.
+static long long daysFromCivil(int y, int m, int d) {
+    y -= m <= 2;
+    long long era = (y >= 0 ? y : y - 399) / 400;
+    long long yoe = y - era * 400;
+    long long doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    long long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static void civilFromDays(long long z, int &y, int &m, int &d) {
+    z += 719468;
+    long long era = (z >= 0 ? z : z - 146096) / 146097;
+    long long doe = z - era * 146097;
+    long long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    long long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    long long mp = (5 * doy + 2) / 153;
+    d = (int)(doy - (153 * mp + 2) / 5 + 1);
+    m = (int)(mp < 10 ? mp + 3 : mp - 9);
+    y = (int)(yoe + era * 400 + (m <= 2));
+}
+
+static inline int64_t floorDiv(int64_t a, int64_t b) { return a / b - (a % b != 0 && (a < 0) != (b < 0)); }
+
+static const size_t TIMESTAMP_TEXT_MAX = 32; // buffer size for Timestamp::format
+
+class Timestamp {
+private:
+    int64_t secs;
+public:
+    static const int64_t NONE = INT64_MIN;
+
+    Timestamp() : secs(NONE) {}
+    explicit Timestamp(int64_t s) : secs(s) {}
+    static Timestamp fromMinutes(int64_t m) { return Timestamp(m * 60); }
+    static Timestamp fromCivil(int y, int mo, int d, int h = 0, int mi = 0, int s = 0) {
+        return Timestamp(((daysFromCivil(y, mo, d) * 24 + h) * 60 + mi) * 60 + s);
+    }
+
+    // "YYYY-MM-DD HH:MM" or "YYYY-MM-DD HH:MM:SS"; month, day and hour may
+    // have one digit ("2025-9-1 9:00", as older files were typed) and a 'T'
+    // may stand for the space. Anything else is !valid().
+    static Timestamp parse(string_view s) {
+        s = trimView(s);
+        static const char seps[] = {'-', '-', ' ', ':', ':'};
+        int v[6] = {0, 0, 0, 0, 0, 0}; // year, month, day, hour, minute, second
+        size_t pos = 0;
+        int last = 0; // index of the last field read
+        for (;; ++last) {
+            size_t start = pos, maxLen = last == 0 ? 4 : 2;
+            while (pos < s.size() && pos - start < maxLen && s[pos] >= '0' && s[pos] <= '9') v[last] = v[last] * 10 + (s[pos++] - '0');
+            size_t len = pos - start;
+            if (len == 0 || ((last == 0 || last >= 4) && len != maxLen)) return Timestamp();
+            if (pos == s.size()) break;
+            if (last == 5 || (s[pos] != seps[last] && !(last == 2 && s[pos] == 'T'))) return Timestamp();
+            ++pos;
+        }
+        if (last < 4) return Timestamp();
+        int y = v[0], mo = v[1], d = v[2], h = v[3], mi = v[4], sec = v[5];
+        static const int monthDays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        if (mo < 1 || mo > 12 || h > 23 || mi > 59 || sec > 59) return Timestamp();
+        bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+        if (d < 1 || d > monthDays[mo - 1] + (mo == 2 && leap)) return Timestamp();
+        return fromCivil(y, mo, d, h, mi, sec);
+    }
 
-    static string nowString() {
-    time_t t = time(0);   // get current time
-    tm local_tm;
+    // local wall-clock time; localtime runs at most once per second per thread
+    static Timestamp now() {
+        static thread_local time_t lastTick = (time_t)-1;
+        static thread_local Timestamp lastNow;
+        time_t t = time(0);
+        if (t == lastTick) return lastNow;
+        tm local_tm;
 #ifdef _WIN32
-    // If localtime_s is not available, fallback to localtime
-    tm* tm_ptr = localtime(&t);
-    if (tm_ptr) local_tm = *tm_ptr;
+        localtime_s(&local_tm, &t);
 #else
-    localtime_r(&t, &local_tm); // Thread-safe POSIX version
+        localtime_r(&t, &local_tm);
 #endif
-    char buf[64];
-    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &local_tm);
-    return string(buf);
+        lastTick = t;
+        lastNow = fromCivil(local_tm.tm_year + 1900, local_tm.tm_mon + 1, local_tm.tm_mday,
+                            local_tm.tm_hour, local_tm.tm_min, local_tm.tm_sec);
+        return lastNow;
+    }
+
+    bool valid() const { return secs != NONE; }
+    int64_t seconds() const { return secs; }
+    int64_t minutes() const { return floorDiv(secs, 60); }
+    int64_t days() const { return floorDiv(secs, 86400); }
+    Timestamp startOfDay() const { return valid() ? Timestamp(days() * 86400) : *this; }
+    Timestamp plusDays(int n) const { return valid() ? Timestamp(secs + (int64_t)n * 86400) : *this; }
+    // Monday 00:00 of the same week (1970-01-01 was a Thursday)
+    Timestamp startOfWeek() const {
+        if (!valid()) return *this;
+        int64_t d = days();
+        return Timestamp((d - (d + 3 - floorDiv(d + 3, 7) * 7)) * 86400);
+    }
+
+    // writes "YYYY-MM-DD HH:MM[:SS]" into buf (TIMESTAMP_TEXT_MAX bytes) and
+    // returns its length, 0 for an invalid timestamp. The last second
+    // formatted on each thread is cached, so repeated output of the same
+    // time (a bill's items, a busy clock) costs one memcpy.
+    size_t format(char *buf, bool withSeconds = true) const {
+        if (!valid()) return 0;
+        static thread_local int64_t cachedSecs = NONE;
+        static thread_local char cached[TIMESTAMP_TEXT_MAX];
+        static thread_local size_t cachedLen = 0;
+        if (secs != cachedSecs) {
+            int y, mo, d;
+            int64_t day = days();
+            int rest = (int)(secs - day * 86400);
+            civilFromDays(day, y, mo, d);
+            int n = snprintf(cached, sizeof(cached), "%04d-%02d-%02d %02d:%02d:%02d", y, mo, d, rest / 3600, rest / 60 % 60, rest % 60);
+            cachedLen = n > 0 ? min<size_t>((size_t)n, sizeof(cached) - 1) : 0;
+            cachedSecs = secs;
+        }
+        size_t len = withSeconds ? cachedLen : cachedLen - 3;
+        memcpy(buf, cached, len);
+        buf[len] = '\0';
+        return len;
+    }
+    string str(bool withSeconds = true) const {
+        char buf[TIMESTAMP_TEXT_MAX];
+        return string(buf, format(buf, withSeconds));
+    }
 
+    bool operator==(const Timestamp &o) const { return secs == o.secs; }
+    bool operator!=(const Timestamp &o) const { return secs != o.secs; }
+    bool operator<(const Timestamp &o) const { return secs < o.secs; }
+    bool operator<=(const Timestamp &o) const { return secs <= o.secs; }
+    bool operator>(const Timestamp &o) const { return secs > o.secs; }
+    bool operator>=(const Timestamp &o) const { return secs >= o.secs; }
+};
 
+// --------------------------
+// Money
+// --------------------------
+// Amounts are whole paisa (hundredths of a rupee) in an int64, so sums are
+// exact and adding never allocates. Text is "2000" for whole amounts and
+// "1234.50" otherwise; parse() reads it without going through double.
+static const size_t MONEY_TEXT_MAX = 32; // buffer size for Money::format
 
-}
+class Money {
+private:
+    int64_t paisa = 0;
+public:
+    Money() {}
+    static Money fromMinor(int64_t m) { Money x; x.paisa = m; return x; }
+    static Money fromMajor(double v) { return fromMinor(llround(v * 100.0)); }
+
+    // "[-]digits[.digits]"; a third decimal rounds half away from zero.
+    // Returns false (and leaves out alone) for anything else.
+    static bool parse(string_view s, Money &out) {
+        s = trimView(s);
+        bool negative = !s.empty() && s[0] == '-';
+        if (!s.empty() && (s[0] == '-' || s[0] == '+')) s.remove_prefix(1);
+        size_t dot = s.find('.');
+        string_view whole = s.substr(0, dot), frac = dot == string_view::npos ? string_view() : s.substr(dot + 1);
+        if ((whole.empty() && frac.empty()) || whole.size() > 15) return false;
+        int64_t v = 0;
+        for (char c : whole) { if (c < '0' || c > '9') return false; v = v * 10 + (c - '0'); }
+        int cents = 0;
+        for (size_t i = 0; i < frac.size(); ++i) {
+            char c = frac[i];
+            if (c < '0' || c > '9') return false;
+            if (i < 2) cents = cents * 10 + (c - '0');
+            else if (i == 2 && c >= '5') ++cents;
+        }
+        if (frac.size() == 1) cents *= 10;
+        v = v * 100 + cents;
+        out = fromMinor(negative ? -v : v);
+        return true;
+    }
+
+    int64_t minor() const { return paisa; }
+    double major() const { return paisa / 100.0; }
+
+    // what is left after taking percent off, to the nearest paisa
+    Money afterDiscount(double percent) const {
+        int64_t basisPoints = llround(percent * 100.0);
+        int64_t off = paisa * basisPoints, half = 5000;
+        off = off >= 0 ? (off + half) / 10000 : -((-off + half) / 10000);
+        return fromMinor(paisa - off);
+    }
+
+    Money& operator+=(Money o) { paisa += o.paisa; return *this; }
+    Money& operator-=(Money o) { paisa -= o.paisa; return *this; }
+    Money operator+(Money o) const { return fromMinor(paisa + o.paisa); }
+    Money operator-(Money o) const { return fromMinor(paisa - o.paisa); }
+    bool operator==(Money o) const { return paisa == o.paisa; }
+    bool operator!=(Money o) const { return paisa != o.paisa; }
+    bool operator<(Money o) const { return paisa < o.paisa; }
+
+    // writes the amount into buf (MONEY_TEXT_MAX bytes) and returns its
+    // length; whole amounts drop ".00" unless alwaysCents
+    size_t format(char *buf, bool alwaysCents = true) const {
+        uint64_t mag = paisa < 0 ? 0 - (uint64_t)paisa : (uint64_t)paisa;
+        unsigned cents = (unsigned)(mag % 100);
+        int n = (cents || alwaysCents)
+            ? snprintf(buf, MONEY_TEXT_MAX, "%s%llu.%02u", paisa < 0 ? "-" : "", (unsigned long long)(mag / 100), cents)
+            : snprintf(buf, MONEY_TEXT_MAX, "%s%llu", paisa < 0 ? "-" : "", (unsigned long long)(mag / 100));
+        return n > 0 ? (size_t)n : 0;
+    }
+    string str(bool alwaysCents = true) const {
+        char buf[MONEY_TEXT_MAX];
+        return string(buf, format(buf, alwaysCents));
+    }
+};
+// one string, so setw() pads the whole amount
+inline ostream& operator<<(ostream &out, Money m) { return out << m.str(); }
+
+// --------------------------
+// Doctor calendar
+// --------------------------
+// A doctor's bookings as [start, end) intervals in minutes, ordered by
+// start. A minute can only be booked once, so slots are unique by
+// construction and a conflict check is one ordered lookup. The calendar is
+// rebuilt from appointments on load and is never written to doctors.txt.
+static const int APPOINTMENT_MINUTES = 1; // the clinic's rule so far: only the same minute clashes
+
+class DoctorCalendar {
+private:
+    struct Booking { long long end; int appointmentId; };
+    map<long long, Booking> bookings; // start -> booking
+public:
+    bool isFree(long long start, long long len = APPOINTMENT_MINUTES) const {
+        auto next = bookings.lower_bound(start);
+        if (next != bookings.end() && next->first < start + len) return false;
+        if (next != bookings.begin() && prev(next)->second.end > start) return false;
+        return true;
+    }
+    bool book(long long start, int appointmentId) {
+        if (!isFree(start)) return false;
+        bookings[start] = {start + APPOINTMENT_MINUTES, appointmentId};
+        return true;
+    }
+    // first minute at or after from where a booking would fit
+    long long firstFreeFrom(long long from) const {
+        long long t = from;
+        auto it = bookings.upper_bound(t);
+        if (it != bookings.begin() && prev(it)->second.end > t) t = prev(it)->second.end;
+        for (; it != bookings.end() && it->first < t + APPOINTMENT_MINUTES; ++it) t = max(t, it->second.end);
+        return t;
+    }
+    // frees start only if that appointment holds it
+    void release(long long start, int appointmentId) {
+        auto it = bookings.find(start);
+        if (it != bookings.end() && it->second.appointmentId == appointmentId) bookings.erase(it);
+    }
+    void clear() { bookings.clear(); }
+    size_t size() const { return bookings.size(); }
+    bool empty() const { return bookings.empty(); }
+
+    // calls f(start, appointmentId) in time order
+    template <typename F>
+    void forEach(F f) const { for (auto &b : bookings) f(b.first, b.second.appointmentId); }
+};
 
-inline bool datetimeConflict(const string &a, const string &b) {
-    if (a.empty() || b.empty()) return false;
-    string A = a.substr(0, min<size_t>(a.size(), 16));
-    string B = b.substr(0, min<size_t>(b.size(), 16));
-    return A == B;
+// from_chars based number parsing: no exceptions, no allocation
+int parseIntView(string_view s, int defaultVal = 0) {
+    s = trimView(s);
+    if (!s.empty() && s[0] == '+') s.remove_prefix(1);
+    int v = 0;
+    auto r = from_chars(s.data(), s.data() + s.size(), v);
+    return r.ec == errc() ? v : defaultVal;
 }
 
-int toIntSafe(const string &s, int defaultVal = 0) {
-    try { return stoi(s); } catch (...) { return defaultVal; }
+double parseDoubleView(string_view s, double defaultVal = 0.0) {
+    s = trimView(s);
+    if (!s.empty() && s[0] == '+') s.remove_prefix(1);
+#if defined(__cpp_lib_to_chars)
+    double v = 0.0;
+    auto r = from_chars(s.data(), s.data() + s.size(), v);
+    return r.ec == errc() ? v : defaultVal;
+#else
+    // older standard libraries only have integer from_chars
+    char buf[64];
+    if (s.empty() || s.size() >= sizeof(buf)) return defaultVal;
+    memcpy(buf, s.data(), s.size()); buf[s.size()] = '\0';
+    char *end = nullptr;
+    double v = strtod(buf, &end);
+    return end == buf ? defaultVal : v;
+#endif
 }
 
-double toDoubleSafe(const string &s, double defaultVal = 0.0) {
-    try { return stod(s); } catch (...) { return defaultVal; }
+int toIntSafe(const string &s, int defaultVal = 0) { return parseIntView(s, defaultVal); }
+
+double toDoubleSafe(const string &s, double defaultVal = 0.0) { return parseDoubleView(s, defaultVal); }
+
+// --------------------------
+// Zero-copy CSV input
+// --------------------------
+// Read-only mapping of a whole file; a missing file reports !exists().
+class MappedFile {
+private:
+    const char *ptr = nullptr;
+    size_t len = 0;
+    bool found = false;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#endif
+public:
+    explicit MappedFile(const string &fname) {
+#ifdef _WIN32
+        file = CreateFileA(fname.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) return;
+        found = true;
+        LARGE_INTEGER sz;
+        if (!GetFileSizeEx(file, &sz) || sz.QuadPart == 0) return;
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!mapping) return;
+        ptr = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (ptr) len = (size_t)sz.QuadPart;
+#else
+        int fd = open(fname.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        found = true;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void *m = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (m != MAP_FAILED) {
+                ptr = (const char*)m; len = (size_t)st.st_size;
+                madvise(m, len, MADV_SEQUENTIAL);
+            }
+        }
+        close(fd);
+#endif
+    }
+    ~MappedFile() {
+#ifdef _WIN32
+        if (ptr) UnmapViewOfFile(ptr);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (ptr) munmap((void*)ptr, len);
+#endif
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool exists() const { return found; }
+    string_view view() const { return string_view(ptr, len); }
+};
+
+// Calls onRow(fields, count) for every non-blank line of fname.
+// Returns false if the file does not exist.
+template <typename F>
+bool forEachCSVRow(const string &fname, F onRow) {
+    MappedFile mf(fname);
+    if (!mf.exists()) return false;
+    tokenizeCSV(mf.view(), onRow);
+    return true;
 }
 
+// adapts a splitCSV row to the fromFields() constructors
+inline vector<string_view> asViews(const vector<string> &r) { return vector<string_view>(r.begin(), r.end()); }
+
+// --------------------------
+// Small thread pool
+// --------------------------
+// Fixed set of workers fed from one queue; wait() blocks until every
+// submitted task has finished.
+class TaskPool {
+private:
+    vector<thread> workers;
+    queue<function<void()>> tasks;
+    mutex m;
+    condition_variable wake, idle;
+    size_t running = 0;
+    bool stopping = false;
+
+    void workerLoop() {
+        while (true) {
+            function<void()> task;
+            {
+                unique_lock<mutex> lk(m);
+                wake.wait(lk, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) return; // stopping
+                task = std::move(tasks.front());
+                tasks.pop();
+                ++running;
+            }
+            task();
+            lock_guard<mutex> lk(m);
+            if (--running == 0 && tasks.empty()) idle.notify_all();
+        }
+    }
+public:
+    explicit TaskPool(size_t n = 0) {
+        if (n == 0) n = max(1u, thread::hardware_concurrency());
+        for (size_t i = 0; i < n; ++i) workers.emplace_back([this] { workerLoop(); });
+    }
+    ~TaskPool() {
+        { lock_guard<mutex> lk(m); stopping = true; }
+        wake.notify_all();
+        for (auto &w : workers) w.join();
+    }
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    void submit(function<void()> task) {
+        { lock_guard<mutex> lk(m); tasks.push(std::move(task)); }
+        wake.notify_one();
+    }
+    void wait() {
+        unique_lock<mutex> lk(m);
+        idle.wait(lk, [this] { return tasks.empty() && running == 0; });
+    }
+};
+
+// --------------------------
+// Memory resources
+// --------------------------
+// The lookup indexes and the history log allocate a node or a small vector
+// per record and keep them for the whole session. With pooling on, each of
+// them draws from a pool of its own instead of the global heap, and
+// clear() hands the memory back to that pool for the next load. A structure
+// is only ever filled by one loader thread and used from the menu thread
+// afterwards, so its pool needs no lock.
+class RecordPool {
+private:
+    pmr::unsynchronized_pool_resource pool;
+    pmr::memory_resource *mr;
+public:
+    explicit RecordPool(bool pooled) : mr(pooled ? static_cast<pmr::memory_resource*>(&pool) : pmr::get_default_resource()) {}
+    RecordPool(const RecordPool&) = delete;
+    RecordPool& operator=(const RecordPool&) = delete;
+    pmr::memory_resource* get() const { return mr; }
+};
+
+// Scratch for one record at a time while loading: allocations are bumps
+// into a fixed buffer and reset() drops them all at once.
+template <size_t Bytes>
+class ScratchArena {
+private:
+    alignas(max_align_t) char buffer[Bytes];
+    pmr::monotonic_buffer_resource arena{buffer, Bytes};
+public:
+    ScratchArena() {}
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+    pmr::memory_resource* get() { return &arena; }
+    void reset() { arena.release(); }
+};
+
 // --------------------------
 // Robust input helpers
 // --------------------------
@@ -199,11 +906,128 @@ double promptDouble(const string &promptText, double defaultVal = -1.0) {
     }
 }
 
+// amounts are read as text so "1234.50" is stored exactly
+Money promptMoney(const string &promptText) {
+    while (true) {
+        cout << promptText << flush;
+        Money m;
+        if (Money::parse(readLineSafe(), m)) return m;
+        cout << "Invalid amount. Try again.\n";
+    }
+}
+
 void pauseConsole() {
     cout << "Press Enter to continue..." << flush;
     readLineSafe();
 }
 
+// --------------------------
+// Interned strings
+// --------------------------
+// Low-cardinality text fields (gender, specialization, insurance provider,
+// roles, appointment type) are 32-bit ids into one process-wide table, so
+// a record holds 4 bytes instead of a string and equal values compare as
+// integers. Interning ignores case and extra spaces and applies a few
+// aliases ("M" -> "Male", "walkin" -> "walk-in"); a value without an alias
+// keeps the spelling it was first seen with, and that is what gets saved.
+// Entries are never removed, so text() takes no lock: the loaders intern
+// from several threads, and an id is only handed out after its text is in
+// place.
+class SymbolTable {
+private:
+    static const size_t CHUNK = 1024, MAX_CHUNKS = 4096; // room for 4M distinct values
+    atomic<string*> chunks[MAX_CHUNKS];
+    atomic<uint32_t> count{0};
+    mutex m;
+    unordered_map<string, uint32_t> byKey; // folded text -> id
+
+    // lower case, trimmed, inner runs of spaces collapsed
+    static string fold(string_view s) {
+        string out;
+        for (char c : s) {
+            if (isspace((unsigned char)c)) { if (!out.empty() && out.back() != ' ') out.push_back(' '); }
+            else out.push_back((char)tolower((unsigned char)c));
+        }
+        if (!out.empty() && out.back() == ' ') out.pop_back();
+        return out;
+    }
+    // folded spelling -> canonical text
+    static const unordered_map<string, string>& aliases() {
+        static const unordered_map<string, string> table = {
+            {"m", "Male"}, {"male", "Male"}, {"f", "Female"}, {"female", "Female"},
+            {"walk-in", "walk-in"}, {"walkin", "walk-in"}, {"walk in", "walk-in"}, {"walk_in", "walk-in"}, {"online", "online"},
+            {"admin", "Admin"}, {"receptionist", "Receptionist"}, {"doctor", "Doctor"}, {"patient", "Patient"},
+        };
+        return table;
+    }
+
+    SymbolTable() {
+        for (auto &c : chunks) c.store(nullptr, memory_order_relaxed);
+        byKey.emplace("", 0);
+        chunks[0].store(new string[CHUNK], memory_order_release); // id 0 is ""
+        count.store(1, memory_order_release);
+    }
+public:
+    ~SymbolTable() { for (auto &c : chunks) delete[] c.load(); }
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    static SymbolTable& global() { static SymbolTable table; return table; }
+
+    uint32_t intern(string_view text) {
+        // per-thread memo of exact spellings, so repeated values skip the lock
+        thread_local unordered_map<string, uint32_t> seen;
+        string raw(text);
+        auto hit = seen.find(raw);
+        if (hit != seen.end()) return hit->second;
+
+        // aliases share the entry of their canonical spelling
+        string key = fold(text);
+        auto alias = aliases().find(key);
+        string canonical = alias != aliases().end() ? alias->second : string(trimView(text));
+        if (alias != aliases().end()) key = fold(canonical);
+        uint32_t id;
+        {
+            lock_guard<mutex> lk(m);
+            auto it = byKey.find(key);
+            if (it != byKey.end()) id = it->second;
+            else {
+                id = count.load(memory_order_relaxed);
+                if (id / CHUNK >= MAX_CHUNKS) throw runtime_error("symbol table full");
+                if (!chunks[id / CHUNK].load(memory_order_relaxed)) chunks[id / CHUNK].store(new string[CHUNK], memory_order_release);
+                chunks[id / CHUNK].load(memory_order_relaxed)[id % CHUNK] = std::move(canonical);
+                byKey.emplace(std::move(key), id);
+                count.store(id + 1, memory_order_release);
+            }
+        }
+        if (seen.size() > 4096) seen.clear();
+        seen.emplace(std::move(raw), id);
+        return id;
+    }
+    const string& text(uint32_t id) const { return chunks[id / CHUNK].load(memory_order_acquire)[id % CHUNK]; }
+    size_t size() const { return count.load(memory_order_acquire); }
+};
+
+// An interned value. Converts from any string (interning it) and back to
+// const string&, so it drops in where a std::string field used to be.
+class Symbol {
+private:
+    uint32_t id = 0; // 0 is ""
+public:
+    Symbol() {}
+    Symbol(string_view text) : id(SymbolTable::global().intern(text)) {}
+    Symbol(const string &text) : Symbol(string_view(text)) {}
+    Symbol(const char *text) : Symbol(string_view(text)) {}
+
+    const string& str() const { return SymbolTable::global().text(id); }
+    operator const string&() const { return str(); }
+    uint32_t code() const { return id; }
+    bool empty() const { return id == 0; }
+    bool operator==(Symbol o) const { return id == o.id; }
+    bool operator!=(Symbol o) const { return id != o.id; }
+};
+inline ostream& operator<<(ostream &out, Symbol s) { return out << s.str(); }
+
 // --------------------------
 // Abstract service
 // --------------------------
@@ -222,7 +1046,7 @@ protected:
     int id;
     string name;
     int age;
-    string gender;
+    Symbol gender;
     string contact;
 public:
     Person() : id(0), age(0) {}
@@ -235,7 +1059,7 @@ public:
     void setName(const string &v) { name = v; }
     int getAge() const { return age; }
     void setAge(int v) { age = v; }
-    string getGender() const { return gender; }
+    Symbol getGender() const { return gender; }
     void setGender(const string &v) { gender = v; }
     string getContact() const { return contact; }
     void setContact(const string &v) { contact = v; }
@@ -244,28 +1068,22 @@ public:
         cout << "ID: " << id << " | Name: " << name << " | Age: " << age << " | Gender: " << gender << " | Contact: " << contact << "\n";
     }
     virtual vector<string> toCSVRow() const = 0;
+    virtual void writeCSV(CsvWriter &w) const = 0; // same row as toCSVRow, without the vector
 };
 
 class Patient : public Person {
 private:
-    string medicalHistory;
     bool insured;
-    string insuranceProvider;
+    Symbol insuranceProvider;
     string nationalId;
 public:
     Patient() : Person(), insured(false) {}
     Patient(int id_, const string &name_, int age_, const string &gender_, const string &contact_, bool insured_ = false, const string &prov = "", const string &nid = "")
-        : Person(id_, name_, age_, gender_, contact_), medicalHistory(""), insured(insured_), insuranceProvider(prov), nationalId(nid) {}
+        : Person(id_, name_, age_, gender_, contact_), insured(insured_), insuranceProvider(prov), nationalId(nid) {}
 
-    void addHistory(const string &entry) {
-        if (!medicalHistory.empty()) medicalHistory += "\n";
-        medicalHistory += entry;
-    }
-    string getHistory() const { return medicalHistory; }
-    void setHistory(const string &h) { medicalHistory = h; }
     bool isInsured() const { return insured; }
     void setInsurance(bool v) { insured = v; }              // <-- added/ensured
-    string getInsuranceProvider() const { return insuranceProvider; }
+    Symbol getInsuranceProvider() const { return insuranceProvider; }
     void setInsuranceProvider(const string &p) { insuranceProvider = p; }
     string getNationalId() const { return nationalId; }
     void setNationalId(const string &v) { nationalId = v; }
@@ -279,47 +1097,49 @@ public:
         if (insured) cout << " | Provider: " << insuranceProvider;
         if (!nationalId.empty()) cout << " | National ID: " << nationalId;
         cout << "\n";
-        if (!medicalHistory.empty()) {
-            cout << "  Medical History:\n";
-            istringstream iss(medicalHistory);
-            string line;
-            while (getline(iss, line)) cout << "   - " << line << "\n";
-        }
     }
 
     vector<string> toCSVRow() const override {
-        return {to_string(id), name, to_string(age), gender, contact, (insured ? "1" : "0"), insuranceProvider, nationalId, medicalHistory};
+        return {to_string(id), name, to_string(age), gender, contact, (insured ? "1" : "0"), insuranceProvider, nationalId};
+    }
+    void writeCSV(CsvWriter &w) const override {
+        w.field(id).field(name).field(age).field(gender).field(contact).field(insured)
+         .field(insuranceProvider).field(nationalId);
+        w.endRow();
     }
 
-    static Patient fromCSV(const vector<string> &r) {
+    static Patient fromFields(const string_view *r, size_t n) {
         Patient p;
-        if (r.size() >= 1) p.id = toIntSafe(r[0], 0);
-        if (r.size() >= 2) p.name = r[1];
-        if (r.size() >= 3) p.age = toIntSafe(r[2], 0);
-        if (r.size() >= 4) p.gender = r[3];
-        if (r.size() >= 5) p.contact = r[4];
-        if (r.size() >= 6) p.insured = (r[5] == "1");
-        if (r.size() >= 7) p.insuranceProvider = r[6];
-        if (r.size() >= 8) p.nationalId = r[7];
-        if (r.size() >= 9) p.medicalHistory = r[8];
+        if (n >= 1) p.id = parseIntView(r[0], 0);
+        if (n >= 2) p.name = r[1];
+        if (n >= 3) p.age = parseIntView(r[2], 0);
+        if (n >= 4) p.gender = r[3];
+        if (n >= 5) p.contact = r[4];
+        if (n >= 6) p.insured = (r[5] == "1");
+        if (n >= 7) p.insuranceProvider = r[6];
+        if (n >= 8) p.nationalId = r[7];
+        // r[8] in older files is the free-text history, now in history.txt
         return p;
     }
+    static Patient fromCSV(const vector<string> &r) { auto v = asViews(r); return fromFields(v.data(), v.size()); }
 };
 
 class Doctor : public Person {
 private:
-    string specialization;
-    vector<string> bookedSlots;
+    Symbol specialization;
+    DoctorCalendar calendar; // derived from appointments, not persisted
     double consultationFee;
 public:
     Doctor() : Person(), consultationFee(0.0) {}
     Doctor(int id_, const string &name_, int age_, const string &gender_, const string &contact_, const string &spec_, double fee = 0.0)
         : Person(id_, name_, age_, gender_, contact_), specialization(spec_), consultationFee(fee) {}
-    string getSpecialization() const { return specialization; }
+    Symbol getSpecialization() const { return specialization; }
     void setSpecialization(const string &v) { specialization = v; }
-    const vector<string> &getBookedSlots() const { return bookedSlots; }
-    void addBookedSlot(const string &s) { bookedSlots.push_back(s); }
-    void setBookedSlots(const vector<string> &v) { bookedSlots = v; }
+    const DoctorCalendar &getCalendar() const { return calendar; }
+    bool isFreeAt(long long minute) const { return calendar.isFree(minute); }
+    long long firstFreeFrom(long long minute) const { return calendar.firstFreeFrom(minute); }
+    bool bookSlot(long long minute, int appointmentId) { return calendar.book(minute, appointmentId); }
+    void releaseSlot(long long minute, int appointmentId) { calendar.release(minute, appointmentId); }
     double getFee() const { return consultationFee; }
     void setFee(double v) { consultationFee = v; }
 
@@ -329,48 +1149,42 @@ public:
         cout << "[Doctor] ";
         Person::displayInfo();
         cout << "  Specialization: " << specialization << " | Fee: " << consultationFee << "\n";
-        if (!bookedSlots.empty()) {
+        if (!calendar.empty()) {
             cout << "  Booked slots: ";
-            for (size_t i = 0; i < bookedSlots.size(); ++i) {
-                cout << bookedSlots[i];
-                if (i + 1 < bookedSlots.size()) cout << ", ";
-            }
+            bool first = true;
+            calendar.forEach([&](long long start, int) {
+                if (!first) cout << ", ";
+                cout << Timestamp::fromMinutes(start).str(false);
+                first = false;
+            });
             cout << "\n";
         }
     }
 
     vector<string> toCSVRow() const override {
-        string slots;
-        for (size_t i = 0; i < bookedSlots.size(); ++i) {
-            slots += bookedSlots[i];
-            if (i + 1 < bookedSlots.size()) slots += ';';
-        }
-        return {to_string(id), name, to_string(age), gender, contact, specialization, to_string(consultationFee), slots};
+        return {to_string(id), name, to_string(age), gender, contact, specialization, to_string(consultationFee)};
+    }
+    void writeCSV(CsvWriter &w) const override {
+        w.field(id).field(name).field(age).field(gender).field(contact).field(specialization).field(consultationFee);
+        w.endRow();
     }
 
-    static Doctor fromCSV(const vector<string> &r) {
+    static Doctor fromFields(const string_view *r, size_t n) {
         Doctor d;
-        if (r.size() >= 1) d.id = toIntSafe(r[0], 0);
-        if (r.size() >= 2) d.name = r[1];
-        if (r.size() >= 3) d.age = toIntSafe(r[2], 0);
-        if (r.size() >= 4) d.gender = r[3];
-        if (r.size() >= 5) d.contact = r[4];
-        if (r.size() >= 6) d.specialization = r[5];
-        if (r.size() >= 7) {
+        if (n >= 1) d.id = parseIntView(r[0], 0);
+        if (n >= 2) d.name = r[1];
+        if (n >= 3) d.age = parseIntView(r[2], 0);
+        if (n >= 4) d.gender = r[3];
+        if (n >= 5) d.contact = r[4];
+        if (n >= 6) d.specialization = r[5];
+        if (n >= 7) {
             // safe parse
-            d.consultationFee = toDoubleSafe(r[6], 0.0);
-        }
-        if (r.size() >= 8) {
-            string s = r[7];
-            string tmp;
-            for (char c : s) {
-                if (c == ';') { if (!tmp.empty()) { d.bookedSlots.push_back(tmp); tmp.clear(); } }
-                else tmp.push_back(c);
-            }
-            if (!tmp.empty()) d.bookedSlots.push_back(tmp);
+            d.consultationFee = parseDoubleView(r[6], 0.0);
         }
+        // older files have a booked-slots column here; the calendar is rebuilt from appointments instead
         return d;
     }
+    static Doctor fromCSV(const vector<string> &r) { auto v = asViews(r); return fromFields(v.data(), v.size()); }
 };
 
 class Staff : public Person {
@@ -378,11 +1192,11 @@ private:
     
     string username;
 public:
-	string role;
+	Symbol role;
     Staff() {}
     Staff(int id_, const string &name_, int age_, const string &gender_, const string &contact_, const string &role_, const string &uname = "")
         : Person(id_, name_, age_, gender_, contact_), role(role_), username(uname) {}
-    string getRole() const { return role; }
+    Symbol getRole() const { return role; }
     void setRole(const string &v) { role = v; }
     string getUsername() const { return username; }
     void setUsername(const string &v) { username = v; }
@@ -400,18 +1214,23 @@ public:
     vector<string> toCSVRow() const override {
         return {to_string(id), name, to_string(age), gender, contact, role, username};
     }
+    void writeCSV(CsvWriter &w) const override {
+        w.field(id).field(name).field(age).field(gender).field(contact).field(role).field(username);
+        w.endRow();
+    }
 
-    static Staff fromCSV(const vector<string> &r) {
+    static Staff fromFields(const string_view *r, size_t n) {
         Staff s;
-        if (r.size() >= 1) s.id = toIntSafe(r[0], 0);
-        if (r.size() >= 2) s.name = r[1];
-        if (r.size() >= 3) s.age = toIntSafe(r[2], 0);
-        if (r.size() >= 4) s.gender = r[3];
-        if (r.size() >= 5) s.contact = r[4];
-        if (r.size() >= 6) s.role = r[5];
-        if (r.size() >= 7) s.username = r[6];
+        if (n >= 1) s.id = parseIntView(r[0], 0);
+        if (n >= 2) s.name = r[1];
+        if (n >= 3) s.age = parseIntView(r[2], 0);
+        if (n >= 4) s.gender = r[3];
+        if (n >= 5) s.contact = r[4];
+        if (n >= 6) s.role = r[5];
+        if (n >= 7) s.username = r[6];
         return s;
     }
+    static Staff fromCSV(const vector<string> &r) { auto v = asViews(r); return fromFields(v.data(), v.size()); }
 };
 
 // --------------------------
@@ -425,27 +1244,27 @@ public:
     PharmacyService() {}
     void loadFromFile(const string &fname) {
         stock.clear(); expiry.clear();
-        ifstream in(fname);
-        if (!in.is_open()) return;
-        string line;
-        while (getline(in, line)) {
-            if (trim(line).empty()) continue;
-            auto row = splitCSV(line);
-            if (row.size() >= 1) {
-                string name = row[0];
-                int qty = (row.size() >= 2) ? toIntSafe(row[1], 0) : 0;
-                string exp = (row.size() >= 3) ? row[2] : "";
+        forEachCSVRow(fname, [&](const string_view *row, size_t n) {
+            if (n >= 1) {
+                string name(row[0]);
+                int qty = (n >= 2) ? parseIntView(row[1], 0) : 0;
+                string exp = (n >= 3) ? string(row[2]) : "";
                 stock[name] = qty; expiry[name] = exp;
             }
-        }
+        });
     }
-    void saveToFile(const string &fname) {
+    void saveToFile(const string &fname) const {
         ofstream out(fname);
+        writeTo(out);
+    }
+    void writeTo(ostream &out) const {
+        CsvWriter w(&out);
         for (auto &kv : stock) {
             string exp = "";
             auto it = expiry.find(kv.first);
             if (it != expiry.end()) exp = it->second;
-            out << joinCSV({kv.first, to_string(kv.second), exp}) << "\n";
+            w.field(kv.first).field(kv.second).field(exp);
+            w.endRow();
         }
     }
     void addMedicine(const string &name, int qty, const string &exp) {
@@ -456,6 +1275,20 @@ public:
         if (it == stock.end() || it->second < qty) return false;
         it->second -= qty; return true;
     }
+    int quantityOf(const string &name) const {
+        auto it = stock.find(name);
+        return it == stock.end() ? 0 : it->second;
+    }
+    string expiryOf(const string &name) const {
+        auto it = expiry.find(name);
+        return it == expiry.end() ? "" : it->second;
+    }
+    const map<string,int>& getStock() const { return stock; }
+    void clear() { stock.clear(); expiry.clear(); }
+    // overwrite (not add to) the stock line, used by journal replay
+    void setMedicine(const string &name, int qty, const string &exp) {
+        stock[name] = qty; expiry[name] = exp;
+    }
     void listMedicines() const {
         cout << "--- Pharmacy Stock ---\n";
         for (auto &kv : stock) {
@@ -488,20 +1321,96 @@ public:
 // --------------------------
 class DiagnosticsService : public HospitalService {
 private:
-    map<int, vector<string>> reports;
+    struct Report { Timestamp at; string text; };
+    map<int, vector<Report>> reports;
 public:
     DiagnosticsService() {}
-    void addReport(int pid, const string &rep) { reports[pid].push_back(nowString() + " | " + rep); }
+    void addReport(int pid, const string &rep) { reports[pid].push_back({Timestamp::now(), rep}); }
     void showReports(int pid) const {
         auto it = reports.find(pid);
         if (it == reports.end() || it->second.empty()) { cout << "No reports for patient " << pid << "\n"; return; }
         cout << "Reports for patient " << pid << ":\n";
-        for (auto &r : it->second) cout << " - " << r << "\n";
+        for (auto &r : it->second) cout << " - " << r.at.str() << " | " << r.text << "\n";
     }
     void performService() override { cout << "Diagnostics service: run tests.\n"; }
     string name() const override { return "Diagnostics"; }
 };
 
+// --------------------------
+// Medical history
+// --------------------------
+// One dated line of a patient's history. Entries migrated from the old
+// free-text column have no time.
+struct HistoryEntry {
+    Timestamp at;
+    string text;
+
+    void writeCSV(CsvWriter &w, int patientId) const {
+        char when[TIMESTAMP_TEXT_MAX];
+        w.field(patientId).field(string_view(when, at.format(when))).field(text);
+        w.endRow();
+    }
+};
+
+static const size_t HISTORY_CHUNK = 16; // entries per chunk
+
+// Per-patient logs kept apart from the Patient records, so copying or
+// scanning patients never touches them. Entries are appended into
+// fixed-size chunks that never move; appending is O(1) and a page of the
+// newest entries is read straight from the tail.
+class HistoryLog {
+private:
+    struct Log {
+        pmr::vector<pmr::vector<HistoryEntry>> chunks; // each reserved to HISTORY_CHUNK, so entries never move
+        size_t count = 0;
+        explicit Log(pmr::memory_resource *mr) : chunks(mr) {}
+    };
+    RecordPool mem;
+    pmr::unordered_map<int, Log> logs{mem.get()};
+
+    const HistoryEntry& entry(const Log &log, size_t i) const { return log.chunks[i / HISTORY_CHUNK][i % HISTORY_CHUNK]; }
+public:
+    explicit HistoryLog(bool pooled = POOLED_INDEXES) : mem(pooled) {}
+
+    void append(int patientId, HistoryEntry e) {
+        Log &log = logs.try_emplace(patientId, mem.get()).first->second;
+        if (log.count % HISTORY_CHUNK == 0) {
+            log.chunks.emplace_back();
+            log.chunks.back().reserve(HISTORY_CHUNK);
+        }
+        log.chunks.back().push_back(std::move(e));
+        ++log.count;
+    }
+
+    size_t count(int patientId) const {
+        auto it = logs.find(patientId);
+        return it == logs.end() ? 0 : it->second.count;
+    }
+
+    // newest first: skips the newest `skip` entries and returns up to `limit`
+    // of the ones before them (pointers stay valid until clear())
+    vector<const HistoryEntry*> recent(int patientId, size_t skip, size_t limit) const {
+        vector<const HistoryEntry*> out;
+        auto it = logs.find(patientId);
+        if (it == logs.end() || skip >= it->second.count) return out;
+        size_t end = it->second.count - skip;
+        size_t begin = end > limit ? end - limit : 0;
+        out.reserve(end - begin);
+        for (size_t i = end; i-- > begin; ) out.push_back(&entry(it->second, i));
+        return out;
+    }
+
+    // f(entry) for every entry of one patient, oldest first
+    template <typename F>
+    void forEach(int patientId, F f) const {
+        auto it = logs.find(patientId);
+        if (it == logs.end()) return;
+        for (size_t i = 0; i < it->second.count; ++i) f(entry(it->second, i));
+    }
+
+    void clear() { logs.clear(); }
+};
+
 // --------------------------
 // Emergency & Surgery services (examples)
 // --------------------------
@@ -523,32 +1432,57 @@ public:
 // Billing & Appointment
 // --------------------------
 
+// The usual line items. Only these are interned; any other description is
+// free text and is kept exactly as it was typed.
+static const char *BILL_CATALOG[] = {"Consultation", "X-ray", "MRI", "Medicine"};
+
+// the catalog code spelled exactly as desc, or an empty Symbol
+inline Symbol billCatalogCode(string_view desc) {
+    for (const char *code : BILL_CATALOG)
+        if (desc == code) return Symbol(code);
+    return Symbol();
+}
+
+struct BillItem {
+    Symbol code;  // catalog entry, empty for a free description
+    string text;  // the free description (only when code is empty)
+    Money amount;
+
+    const string& desc() const { return code.empty() ? text : code.str(); }
+};
+
+// A timestamp field as it is saved: the formatted time, or the text it was
+// loaded from when that was not a date parse() reads (so it is never lost).
+inline string_view timestampText(Timestamp t, const string &loaded, char *buf, bool withSeconds = true) {
+    return t.valid() ? string_view(buf, t.format(buf, withSeconds)) : string_view(loaded);
+}
+
 // Bill structure
 struct Bill {
     int billId;
     int patientId;
-    vector<pair<string,double>> items;
-    string createdAt;
+    Timestamp createdAt;
+    string createdAtText; // the loaded text when parse() could not read it; written back as is
     bool insured;
     double coveragePercent;
 
     Bill() : billId(0), patientId(0), insured(false), coveragePercent(0.0) {}
     Bill(int id, int pid, bool ins, double cov) 
         : billId(id), patientId(pid), insured(ins), coveragePercent(cov) { 
-        createdAt = nowString(); 
+        createdAt = Timestamp::now(); 
     }
 
-    void addItem(const string &desc, double amt) { items.push_back({desc, amt}); }
-
-    double base() const {
-        double sum = 0;
-        for (auto &it : items) sum += it.second;
-        return sum;
+    void addItem(string_view desc, Money amount) {
+        Symbol code = billCatalogCode(desc);
+        items.push_back({code, code.empty() ? string(desc) : string(), amount});
+        subtotal += amount;
     }
+    const vector<BillItem>& lineItems() const { return items; }
 
-    double total() const {
-        double b = base();
-        return insured ? b * (1.0 - coveragePercent/100.0) : b;
+    Money base() const { return subtotal; }
+
+    Money total() const {
+        return insured ? subtotal.afterDiscount(coveragePercent) : subtotal;
     }
 
     // Formatted colorized print
@@ -557,7 +1491,7 @@ struct Bill {
         cout << "=====================================================\n";
         cout << " BILL ID: " << billId 
              << " | Patient ID: " << patientId 
-             << " | Created: " << createdAt << "\n";
+             << " | Created: " << (createdAt.valid() ? createdAt.str() : createdAtText) << "\n";
         cout << "=====================================================\n";
 
         setColor(14); // Yellow headers
@@ -567,111 +1501,1679 @@ struct Bill {
         setColor(7); // White items
         cout << "-----------------------------------------------------\n";
         for (auto &it : items) {
-            cout << setw(30) << left << it.first 
-                 << setw(15) << right << fixed << setprecision(2) << it.second << "\n";
+            cout << setw(30) << left << it.desc() 
+                 << setw(15) << right << it.amount << "\n";
         }
 
         cout << "-----------------------------------------------------\n";
         setColor(10); // Green totals
         cout << setw(30) << left << "Base Amount:" 
-             << setw(15) << right << fixed << setprecision(2) << base() << "\n";
+             << setw(15) << right << base() << "\n";
 
         if (insured) {
             cout << setw(30) << left << "Insurance Coverage:" 
-                 << setw(15) << right << coveragePercent << "%\n";
+                 << setw(15) << right << fixed << setprecision(2) << coveragePercent << "%\n";
         }
 
         cout << setw(30) << left << "Total Payable:" 
-             << setw(15) << right << fixed << setprecision(2) << total() << "\n";
+             << setw(15) << right << total() << "\n";
         setColor(7); // Reset
         cout << "=====================================================\n";
     }
 
-    // CSV export
+    // CSV export (items as "desc#amount;...")
     vector<string> toCSV() const {
-        ostringstream oss;
+        string list;
         for (size_t i=0; i<items.size(); ++i) {
-            oss << items[i].first << "#" << items[i].second;
-            if (i+1<items.size()) oss << ";";
+            if (i) list += ';';
+            list += items[i].desc();
+            list += '#';
+            list += items[i].amount.str(false);
         }
         return {to_string(billId), to_string(patientId), (insured ? "1":"0"), 
-                to_string(coveragePercent), createdAt, oss.str()};
+                to_string(coveragePercent), createdAt.valid() ? createdAt.str() : createdAtText, list};
+    }
+    void writeCSV(CsvWriter &w) const {
+        char when[TIMESTAMP_TEXT_MAX], amount[MONEY_TEXT_MAX];
+        w.field(billId).field(patientId).field(insured).field(coveragePercent).field(timestampText(createdAt, createdAtText, when));
+        size_t start = w.beginField();
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (i) w.part(';');
+            w.part(items[i].desc()).part('#').part(string_view(amount, items[i].amount.format(amount, false)));
+        }
+        w.endField(start);
+        w.endRow();
     }
 
     // CSV import
-    static Bill fromCSV(const vector<string> &r) {
+    static Bill fromFields(const string_view *r, size_t n) {
         Bill b;
-        if (r.size()>=1) b.billId = toIntSafe(r[0],0);
-        if (r.size()>=2) b.patientId = toIntSafe(r[1],0);
-        if (r.size()>=3) b.insured = (r[2]=="1");
-        if (r.size()>=4) b.coveragePercent = toDoubleSafe(r[3], 0.0);
-        if (r.size()>=5) b.createdAt = r[4];
-        if (r.size()>=6) {
-            string s = r[5];
-            string cur;
-            for (char c : s) {
-                if (c == ';') {
-                    if (!cur.empty()) {
-                        auto pos = cur.find('#');
-                        if (pos != string::npos) {
-                            double amt = toDoubleSafe(cur.substr(pos+1), 0.0);
-                            b.items.push_back({cur.substr(0,pos), amt});
-                        }
-                    }
-                    cur.clear();
-                } else cur.push_back(c);
-            }
-            if (!cur.empty()) {
+        if (n>=1) b.billId = parseIntView(r[0],0);
+        if (n>=2) b.patientId = parseIntView(r[1],0);
+        if (n>=3) b.insured = (r[2]=="1");
+        if (n>=4) b.coveragePercent = parseDoubleView(r[3], 0.0);
+        if (n>=5) { b.createdAt = Timestamp::parse(r[4]); if (!b.createdAt.valid()) b.createdAtText = string(r[4]); }
+        if (n>=6) {
+            string_view s = r[5];
+            while (!s.empty()) {
+                size_t semi = s.find(';');
+                string_view cur = s.substr(0, semi);
                 auto pos = cur.find('#');
-                if (pos != string::npos) {
-                    double amt = toDoubleSafe(cur.substr(pos+1), 0.0);
-                    b.items.push_back({cur.substr(0,pos), amt});
+                if (pos != string_view::npos) {
+                    // older files may hold "1e+06"-style amounts
+                    Money amt;
+                    if (!Money::parse(cur.substr(pos+1), amt)) amt = Money::fromMajor(parseDoubleView(cur.substr(pos+1), 0.0));
+                    b.addItem(cur.substr(0,pos), amt);
                 }
+                if (semi == string_view::npos) break;
+                s.remove_prefix(semi + 1);
             }
         }
         return b;
     }
+    static Bill fromCSV(const vector<string> &r) { auto v = asViews(r); return fromFields(v.data(), v.size()); }
+
+private:
+    vector<BillItem> items;
+    Money subtotal; // running sum of items, kept by addItem
+};
+
+
+
+struct Appointment {
+    int id;
+    int patientId;
+    int doctorId;
+    Timestamp datetime; // minute precision
+    string datetimeText; // the loaded text when parse() could not read it; written back as is
+    Symbol type;
+    string reason;
+    Appointment() : id(0), patientId(0), doctorId(0) {}
+    string whenText() const { return datetime.valid() ? datetime.str(false) : datetimeText; }
+    vector<string> toCSV() const { return {to_string(id), to_string(patientId), to_string(doctorId), whenText(), type, reason}; }
+    void writeCSV(CsvWriter &w) const {
+        char when[TIMESTAMP_TEXT_MAX];
+        w.field(id).field(patientId).field(doctorId).field(timestampText(datetime, datetimeText, when, false)).field(type).field(reason);
+        w.endRow();
+    }
+    static Appointment fromFields(const string_view *r, size_t n) {
+        Appointment a;
+        if (n>=1) a.id = parseIntView(r[0],0);
+        if (n>=2) a.patientId = parseIntView(r[1],0);
+        if (n>=3) a.doctorId = parseIntView(r[2],0);
+        if (n>=4) { a.datetime = Timestamp::parse(r[3]); if (!a.datetime.valid()) a.datetimeText = string(r[3]); }
+        if (n>=5) a.type = r[4];
+        if (n>=6) a.reason = r[5];
+        return a;
+    }
+    static Appointment fromCSV(const vector<string> &r) { auto v = asViews(r); return fromFields(v.data(), v.size()); }
+};
+
+// --------------------------
+// User struct for login
+// --------------------------
+struct User {
+    string username;
+    Symbol role;
+    string password;
+    int linkedId; // for patient or staff
+    vector<string> toCSV() const { return {username, role, password, to_string(linkedId)}; }
+    void writeCSV(CsvWriter &w) const {
+        w.field(username).field(role).field(password).field(linkedId);
+        w.endRow();
+    }
+    static User fromFields(const string_view *r, size_t n) {
+        User u;
+        u.linkedId = 0;
+        if (n>=1) u.username = r[0];
+        if (n>=2) u.role = r[1];
+        if (n>=3) u.password = r[2];
+        if (n>=4) u.linkedId = parseIntView(r[3],0);
+        return u;
+    }
+    static User fromCSV(const vector<string> &r) { auto v = asViews(r); return fromFields(v.data(), v.size()); }
+};
+
+// --------------------------
+// User table
+// --------------------------
+// Accounts by username. Records sit in a deque in insertion order and never
+// move; lookups go through an open-addressing index of (hash, record) slots
+// with linear probing. A slot keeps the username's full hash, so a probe
+// only compares strings when the hashes agree and growing the index never
+// rehashes a name. Accounts are never removed one at a time.
+class UserTable {
+public:
+    static const uint32_t NONE = UINT32_MAX;
+private:
+    struct Slot {
+        uint64_t hash = 0;
+        uint32_t record = NONE; // NONE: empty
+    };
+    deque<User> records;
+    vector<Slot> slots; // power-of-two size, at most half full
+
+    static uint64_t hashOf(string_view name) { return std::hash<string_view>()(name); }
+
+    // slot holding name, or the empty slot where it would go
+    size_t probe(string_view name, uint64_t h) const {
+        size_t mask = slots.size() - 1;
+        for (size_t i = h & mask;; i = (i + 1) & mask) {
+            const Slot &s = slots[i];
+            if (s.record == NONE || (s.hash == h && records[s.record].username == name)) return i;
+        }
+    }
+    void grow() {
+        vector<Slot> old(max<size_t>(16, slots.size() * 2));
+        old.swap(slots);
+        size_t mask = slots.size() - 1;
+        for (const Slot &s : old) {
+            if (s.record == NONE) continue;
+            size_t i = s.hash & mask;
+            while (slots[i].record != NONE) i = (i + 1) & mask;
+            slots[i] = s;
+        }
+    }
+
+public:
+    size_t size() const { return records.size(); }
+    bool empty() const { return records.empty(); }
+    void clear() { records.clear(); slots.clear(); }
+    deque<User>::const_iterator begin() const { return records.begin(); }
+    deque<User>::const_iterator end() const { return records.end(); }
+
+    // record number of name, or NONE
+    uint32_t find(string_view name) const {
+        if (slots.empty()) return NONE;
+        return slots[probe(name, hashOf(name))].record;
+    }
+    size_t count(string_view name) const { return find(name) == NONE ? 0 : 1; }
+    const User& at(uint32_t record) const { return records[record]; }
+
+    // the account called name, added with just that username if missing
+    User& operator[](const string &name) {
+        if ((records.size() + 1) * 2 > slots.size()) grow();
+        uint64_t h = hashOf(name);
+        Slot &s = slots[probe(name, h)];
+        if (s.record == NONE) {
+            User u{name, "", "", 0};
+            records.push_back(std::move(u));
+            s.hash = h;
+            s.record = (uint32_t)(records.size() - 1);
+        }
+        return records[s.record];
+    }
+};
+
+// What authenticate hands out: names one account in the user table without
+// copying it. Good for the life of the database.
+struct Session {
+    uint32_t user = UserTable::NONE;
+    explicit operator bool() const { return user != UserTable::NONE; }
+};
+
+// --------------------------
+// Durable file replacement
+// --------------------------
+// A table is written to "<file>.tmp", synced, and renamed over the old
+// file, so a crash leaves either the old or the new version, never half of
+// one. Syncing is the slow part; the writer below batches it.
+static bool syncFile(const string &fname) {
+#ifdef _WIN32
+    HANDLE h = CreateFileA(fname.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    bool ok = FlushFileBuffers(h) != 0;
+    CloseHandle(h);
+    return ok;
+#else
+    int fd = open(fname.c_str(), O_WRONLY);
+    if (fd < 0) return false;
+#if defined(__APPLE__)
+    bool ok = fsync(fd) == 0;
+#else
+    bool ok = fdatasync(fd) == 0;
+#endif
+    close(fd);
+    return ok;
+#endif
+}
+
+// makes finished renames in the working directory durable
+static bool syncDirectory() {
+#ifndef _WIN32
+    int fd = open(".", O_RDONLY);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+#else
+    return true; // NTFS commits the rename with MOVEFILE_WRITE_THROUGH
+#endif
+}
+
+static bool replaceFile(const string &tmp, const string &fname) {
+#ifdef _WIN32
+    return MoveFileExA(tmp.c_str(), fname.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(tmp.c_str(), fname.c_str()) == 0;
+#endif
+}
+
+// --------------------------
+// Background persistence
+// --------------------------
+// All file output goes through one writer thread so the menus never wait
+// on the disk. Jobs run in the order they were queued, with two shortcuts
+// for bursts: journal lines queued back to back go out in one append, and
+// a whole-file write replaces a still-pending write of the same file.
+//
+// In durable mode the thread waits a short window after the first job
+// arrives so that saves landing close together share one commit. The window
+// is as long as the last sync took, capped at GROUP_COMMIT_WINDOW, and it
+// closes early once as many saves have arrived as there were callers
+// waiting on the previous commit. In each commit every
+// temp file in the batch is written, synced, then renamed, with a single
+// directory sync at the end. A truncate is a barrier: files queued before
+// it are committed first, so a compaction never empties the journal before
+// the rewritten tables are safe. If any write, sync or rename has failed by then,
+// the truncate is skipped, and so is every later truncate in this
+// session: the journal still holds the changes the old base file
+// lacks, and replaying it over a newer base file is harmless.
+// flush() blocks until everything queued so far is on disk; waitFor(ticket)
+// blocks only until one particular save is. Both return false if a write
+// they waited for failed; lastError() says which.
+static const chrono::microseconds GROUP_COMMIT_WINDOW(2000);
+
+class PersistenceWriter {
+public:
+    typedef function<void(ostream&)> FileContent;
+private:
+    struct Job {
+        enum Kind { APPEND, WRITE_FILE, TRUNCATE } kind;
+        string fname;
+        string text;         // APPEND: the lines
+        FileContent content; // WRITE_FILE
+        bool binary;
+    };
+    deque<Job> jobs;
+    mutex m;
+    condition_variable wake, idle;
+    bool busy = false, stopping = false;
+    const bool durable;
+    const chrono::microseconds window;
+    uint64_t issued = 0, committed = 0; // save tickets
+    size_t waiters = 0, lastWaiters = 0; // callers blocked in waitFor()
+    size_t coalesced = 0, commits = 0;
+    vector<pair<uint64_t, uint64_t>> failedBatches; // (first, last] tickets of batches with a failed write
+    size_t failuresSeen = 0; // failedBatches already reported by flush()
+    string lastErrorText;
+    chrono::microseconds lastSync{0}; // worker thread only
+    bool skipTruncates = false;        // worker thread only: set by the first failed write
+    vector<string> batchErrors;        // worker thread only
+    thread worker; // last member: started once the queue exists
+
+    // renames every pending temp file and syncs what was appended;
+    // false if any of it failed
+    bool commit(vector<string> &renames, vector<string> &appended) {
+        if (renames.empty() && appended.empty()) return true;
+        size_t errorsBefore = batchErrors.size();
+        if (durable) {
+            auto t0 = chrono::steady_clock::now();
+            for (auto &f : renames) if (!syncFile(f + ".tmp")) batchErrors.push_back("could not sync " + f + ".tmp");
+            for (auto &f : appended) if (!syncFile(f)) batchErrors.push_back("could not sync " + f);
+            lastSync = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - t0);
+        }
+        for (auto &f : renames) {
+            if (!replaceFile(f + ".tmp", f)) {
+                batchErrors.push_back("could not replace " + f);
+                remove((f + ".tmp").c_str()); // keep the old file
+            }
+        }
+        if (durable && !renames.empty() && !syncDirectory()) batchErrors.push_back("could not sync the data folder");
+        renames.clear();
+        appended.clear();
+        ++commits;
+        return batchErrors.size() == errorsBefore;
+    }
+
+    static void addOnce(vector<string> &v, const string &f) {
+        if (find(v.begin(), v.end(), f) == v.end()) v.push_back(f);
+    }
+
+    // false if anything in the batch failed; the reasons are in batchErrors
+    bool runBatch(deque<Job> &batch) {
+        vector<string> renames, appended;
+        batchErrors.clear();
+        for (auto &job : batch) {
+            if (job.kind == Job::APPEND) {
+                ofstream out(job.fname, ios::app);
+                out << job.text;
+                out.flush();
+                if (out) addOnce(appended, job.fname);
+                else batchErrors.push_back("could not append to " + job.fname);
+            } else if (job.kind == Job::TRUNCATE) {
+                commit(renames, appended);
+                if (!batchErrors.empty()) skipTruncates = true;
+                if (skipTruncates) {
+                    batchErrors.push_back("kept " + job.fname + " because an earlier write failed");
+                    continue;
+                }
+                ofstream out(job.fname, ios::trunc);
+                out.close();
+                if (!out || (durable && !syncFile(job.fname))) batchErrors.push_back("could not empty " + job.fname);
+            } else {
+                // a file that was appended to earlier in the batch must be
+                // committed before it is replaced
+                if (find(appended.begin(), appended.end(), job.fname) != appended.end()) commit(renames, appended);
+                string tmp = job.fname + ".tmp";
+                bool ok;
+                {
+                    ofstream out(tmp, job.binary ? ios::binary | ios::trunc : ios::trunc);
+                    job.content(out);
+                    out.flush();
+                    ok = out.good();
+                }
+                if (ok) addOnce(renames, job.fname);
+                else {
+                    remove(tmp.c_str()); // keep the old file
+                    batchErrors.push_back("could not write " + tmp);
+                }
+            }
+        }
+        commit(renames, appended);
+        if (!batchErrors.empty()) skipTruncates = true;
+        return batchErrors.empty();
+    }
+
+    void run() {
+        unique_lock<mutex> lk(m);
+        while (true) {
+            wake.wait(lk, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) return; // stopping and drained
+            auto wait = min(window, lastSync);
+            if (durable && wait.count() > 0 && !stopping)
+                wake.wait_for(lk, wait, [this] { return stopping || issued - committed >= max<size_t>(lastWaiters, 2); });
+            deque<Job> batch;
+            batch.swap(jobs);
+            uint64_t first = committed, ticket = issued;
+            busy = true;
+            lk.unlock();
+            bool ok = runBatch(batch);
+            lk.lock();
+            if (!ok) {
+                failedBatches.push_back({first, ticket});
+                lastErrorText.clear();
+                for (auto &e : batchErrors) lastErrorText += (lastErrorText.empty() ? "" : "; ") + e;
+            }
+            busy = false;
+            committed = ticket;
+            lastWaiters = waiters;
+            idle.notify_all();
+        }
+    }
+public:
+    explicit PersistenceWriter(bool durable_ = true, chrono::microseconds window_ = GROUP_COMMIT_WINDOW)
+        : durable(durable_), window(window_), worker([this] { run(); }) {}
+    ~PersistenceWriter() {
+        { lock_guard<mutex> lk(m); stopping = true; }
+        wake.notify_one();
+        worker.join();
+    }
+    PersistenceWriter(const PersistenceWriter&) = delete;
+    PersistenceWriter& operator=(const PersistenceWriter&) = delete;
+
+    // each call returns a ticket for waitFor()
+    uint64_t append(const string &fname, const string &line) {
+        uint64_t ticket;
+        {
+            lock_guard<mutex> lk(m);
+            if (!jobs.empty() && jobs.back().kind == Job::APPEND && jobs.back().fname == fname) {
+                jobs.back().text += line; ++coalesced;
+            } else jobs.push_back({Job::APPEND, fname, line, nullptr, false});
+            ticket = ++issued;
+        }
+        wake.notify_one();
+        return ticket;
+    }
+    uint64_t writeFile(const string &fname, FileContent content, bool binary = false) {
+        uint64_t ticket;
+        {
+            lock_guard<mutex> lk(m);
+            auto it = find_if(jobs.begin(), jobs.end(), [&](const Job &j) { return j.kind == Job::WRITE_FILE && j.fname == fname; });
+            if (it != jobs.end()) { it->content = std::move(content); it->binary = binary; ++coalesced; }
+            else jobs.push_back({Job::WRITE_FILE, fname, "", std::move(content), binary});
+            ticket = ++issued;
+        }
+        wake.notify_one();
+        return ticket;
+    }
+    uint64_t truncate(const string &fname) {
+        uint64_t ticket;
+        { lock_guard<mutex> lk(m); jobs.push_back({Job::TRUNCATE, fname, "", nullptr, false}); ticket = ++issued; }
+        wake.notify_one();
+        return ticket;
+    }
+    // false if the batch that carried this ticket had a failed write
+    bool waitFor(uint64_t ticket) {
+        unique_lock<mutex> lk(m);
+        ++waiters;
+        idle.wait(lk, [&] { return committed >= ticket; });
+        --waiters;
+        for (auto &b : failedBatches) if (ticket > b.first && ticket <= b.second) return false;
+        return true;
+    }
+    // false if any write failed since the last flush()
+    bool flush() {
+        unique_lock<mutex> lk(m);
+        idle.wait(lk, [this] { return jobs.empty() && !busy; });
+        bool ok = failuresSeen == failedBatches.size();
+        failuresSeen = failedBatches.size();
+        return ok;
+    }
+    string lastError() { lock_guard<mutex> lk(m); return lastErrorText; }
+    size_t coalescedCount() { lock_guard<mutex> lk(m); return coalesced; }
+    size_t commitCount() { lock_guard<mutex> lk(m); return commits; }
+};
+
+// --------------------------
+// Mutation journal
+// --------------------------
+// Each mutation appends one small record instead of rewriting every file.
+// Records are whole-row upserts or erases, so replaying them on top of a
+// base file that already contains the change gives the same result.
+//   U user | P patient | D doctor | S staff | A appointment | X cancel appointment
+//   B bill | M medicine (name,qty,expiry)
+class Journal {
+private:
+    string fname;
+    PersistenceWriter &writer;
+    CsvWriter line; // reused for every record
+    size_t records = 0;
+public:
+    Journal(const string &f, PersistenceWriter &w) : fname(f), writer(w), line(nullptr, 256) {}
+
+    // rec is any record with writeCSV()
+    template <typename Rec>
+    void append(char op, const Rec &rec) {
+        line.clear();
+        line.field(string_view(&op, 1));
+        rec.writeCSV(line);
+        writer.append(fname, line.str());
+        ++records;
+    }
+    void append(char op, const vector<string> &row) {
+        line.clear();
+        line.field(string_view(&op, 1));
+        for (auto &f : row) line.field(f);
+        line.endRow();
+        writer.append(fname, line.str());
+        ++records;
+    }
+
+    // calls apply(op, fields, count) for every record in file order; a
+    // record's fields live in a scratch arena that is reset after it
+    template <typename F>
+    void replay(F apply) {
+        records = 0;
+        ifstream in(fname);
+        if (!in.is_open()) return;
+        ScratchArena<8192> scratch;
+        string line;
+        while (getline(in, line)) {
+            if (line.size() < 2 || line[1] != ',') continue;
+            {
+                auto row = splitCSV(string_view(line).substr(2), scratch.get());
+                pmr::vector<string_view> fields(row.begin(), row.end(), scratch.get());
+                apply(line[0], fields.data(), fields.size());
+            }
+            scratch.reset();
+            ++records;
+        }
+    }
+
+    void truncate() {
+        writer.truncate(fname);
+        records = 0;
+    }
+
+    size_t size() const { return records; }
+};
+
+// --------------------------
+// Lazy history tables
+// --------------------------
+// Offset index over appointments.txt or bills.txt. Building it only reads
+// the id/patient/doctor columns; a full record is parsed the first time it
+// is asked for. Once every row has been taken the index is dropped and the
+// table behaves like an eagerly loaded one.
+struct LazyRow {
+    int id;
+    int patientId;
+    int doctorId; // -1 for bills
+    size_t offset;
+    uint32_t length;
+    bool taken;   // already materialized (and maybe erased since)
+};
+
+class LazyIndex {
+private:
+    unique_ptr<MappedFile> file;
+public:
+    bool enabled = false; // table is in lazy mode and not fully materialized yet
+    bool built = false;
+    vector<LazyRow> rows; // sorted by id; for a repeated id the last line wins
+    int maxId = 0;
+    map<int, vector<uint32_t>> byPatient, byDoctor; // owner -> positions in rows (byDoctor: appointments only)
+
+    void build(const string &fname, bool hasDoctor) {
+        built = true;
+        file.reset(new MappedFile(fname));
+        string_view data = file->view();
+        tokenizeCSVRows(data, [&](const string_view *f, size_t n, string_view row) {
+            LazyRow r;
+            r.id = n >= 1 ? parseIntView(f[0], 0) : 0;
+            r.patientId = n >= 2 ? parseIntView(f[1], 0) : 0;
+            r.doctorId = hasDoctor && n >= 3 ? parseIntView(f[2], 0) : -1;
+            r.offset = (size_t)(row.data() - data.data());
+            r.length = (uint32_t)row.size();
+            r.taken = false;
+            rows.push_back(r);
+            maxId = max(maxId, r.id);
+        });
+        stable_sort(rows.begin(), rows.end(), [](const LazyRow &a, const LazyRow &b) { return a.id < b.id; });
+        // keep the last line of each id, like map assignment in the eager loader
+        vector<LazyRow> unique;
+        for (auto &r : rows) {
+            if (!unique.empty() && unique.back().id == r.id) unique.back() = r;
+            else unique.push_back(r);
+        }
+        rows.swap(unique);
+        for (uint32_t i = 0; i < rows.size(); ++i) {
+            byPatient[rows[i].patientId].push_back(i);
+            if (hasDoctor) byDoctor[rows[i].doctorId].push_back(i);
+        }
+    }
+
+    // calls f(row) for every row listed for owner in byPatient or byDoctor
+    template <typename F>
+    void forEachRowOf(const map<int, vector<uint32_t>> &owners, int owner, F f) {
+        auto it = owners.find(owner);
+        if (it == owners.end()) return;
+        for (uint32_t i : it->second) f(rows[i]);
+    }
+
+    LazyRow* find(int id) {
+        auto it = lower_bound(rows.begin(), rows.end(), id, [](const LazyRow &r, int v) { return r.id < v; });
+        return (it != rows.end() && it->id == id) ? &*it : nullptr;
+    }
+
+    // parses one row and hands its fields to onRow
+    template <typename F>
+    void parse(const LazyRow &r, F onRow) const {
+        tokenizeCSV(file->view().substr(r.offset, r.length), onRow);
+    }
+
+    // every row is materialized: unmap the file and stop being lazy
+    void release() {
+        file.reset();
+        rows.clear(); rows.shrink_to_fit();
+        byPatient.clear(); byDoctor.clear();
+        enabled = false;
+    }
+};
+
+// --------------------------
+// Appointment lookup indexes
+// --------------------------
+// owner id (patient or doctor) -> that owner's appointment ids, ordered by
+// time and then id. The database keeps one per owner kind in step with
+// its appointments map, so a lookup costs O(k log n) for k results.
+class AppointmentIndex {
+private:
+    RecordPool mem;
+    pmr::map<int, pmr::set<pair<int64_t, int>>> byOwner{mem.get()}; // owner -> (seconds, id)
+public:
+    explicit AppointmentIndex(bool pooled = POOLED_INDEXES) : mem(pooled) {}
+    void add(int owner, Timestamp at, int id) { byOwner[owner].insert({at.seconds(), id}); }
+    void remove(int owner, Timestamp at, int id) {
+        auto it = byOwner.find(owner);
+        if (it == byOwner.end()) return;
+        it->second.erase({at.seconds(), id});
+        if (it->second.empty()) byOwner.erase(it);
+    }
+    void clear() { byOwner.clear(); }
+
+    // calls f(id) for each of owner's appointments, earliest first
+    template <typename F>
+    void forEach(int owner, F f) const {
+        auto it = byOwner.find(owner);
+        if (it == byOwner.end()) return;
+        for (auto &e : it->second) f(e.second);
+    }
+    // same, limited to from <= time < to
+    template <typename F>
+    void forEachBetween(int owner, Timestamp from, Timestamp to, F f) const {
+        auto it = byOwner.find(owner);
+        if (it == byOwner.end()) return;
+        for (auto e = it->second.lower_bound({from.seconds(), INT_MIN}); e != it->second.end() && e->first < to.seconds(); ++e) f(e->second);
+    }
+};
+
+// --------------------------
+// Patient name index
+// --------------------------
+// Case-insensitive trigram index over names. Each name is lowercased, its
+// whitespace collapsed, and indexed as " " + name, so the space before a
+// word marks a word start: the query "has" in PREFIX mode looks up " ha"
+// and "has" and finds "Ali Hassan". A query is answered by intersecting the
+// posting lists of its trigrams (smallest list first) and checking the few
+// candidates left against the stored name. Updates touch only the
+// trigrams of the one name that changed.
+class TrigramIndex {
+public:
+    enum Mode { SUBSTRING, PREFIX }; // PREFIX: the query starts a word of the name
+private:
+    RecordPool mem;
+    pmr::unordered_map<uint32_t, pmr::vector<int>> postings{mem.get()}; // trigram -> sorted ids
+    pmr::unordered_map<int, string> names{mem.get()};                   // id -> normalized name
+
+    static uint32_t key(const char *p) { return (uint32_t)(uint8_t)p[0] << 16 | (uint32_t)(uint8_t)p[1] << 8 | (uint8_t)p[2]; }
+    static vector<uint32_t> trigramsOf(const string &text) {
+        vector<uint32_t> keys;
+        for (size_t i = 0; i + 3 <= text.size(); ++i) keys.push_back(key(text.data() + i));
+        sort(keys.begin(), keys.end());
+        keys.erase(unique(keys.begin(), keys.end()), keys.end());
+        return keys;
+    }
+    void addPostings(int id, const string &norm) {
+        for (uint32_t k : trigramsOf(" " + norm)) {
+            pmr::vector<int> &list = postings[k];
+            if (list.empty() || list.back() < id) { list.push_back(id); continue; } // ids mostly arrive in order
+            auto it = lower_bound(list.begin(), list.end(), id);
+            if (it == list.end() || *it != id) list.insert(it, id);
+        }
+    }
+    void removePostings(int id, const string &norm) {
+        for (uint32_t k : trigramsOf(" " + norm)) {
+            auto p = postings.find(k);
+            if (p == postings.end()) continue;
+            auto it = lower_bound(p->second.begin(), p->second.end(), id);
+            if (it != p->second.end() && *it == id) p->second.erase(it);
+            if (p->second.empty()) postings.erase(p);
+        }
+    }
+    // lower is better: exact name, name prefix, word prefix, anywhere; -1 = no match
+    static int matchRank(const string &name, const string &q, Mode mode) {
+        if (name.compare(0, q.size(), q) == 0) return name.size() == q.size() ? 0 : 1;
+        size_t at = name.find(q);
+        while (at != string::npos && name[at - 1] != ' ') {
+            if (mode == SUBSTRING) return 3;
+            at = name.find(q, at + 1);
+        }
+        return at == string::npos ? -1 : 2;
+    }
+public:
+    explicit TrigramIndex(bool pooled = POOLED_INDEXES) : mem(pooled) {}
+
+    static string normalize(string_view s) {
+        string out;
+        out.reserve(s.size());
+        for (char c : s) {
+            if (isspace((unsigned char)c)) { if (!out.empty() && out.back() != ' ') out.push_back(' '); }
+            else out.push_back((char)tolower((unsigned char)c));
+        }
+        if (!out.empty() && out.back() == ' ') out.pop_back();
+        return out;
+    }
+
+    void set(int id, string_view text) {
+        string norm = normalize(text);
+        auto it = names.find(id);
+        if (it != names.end()) {
+            if (it->second == norm) return;
+            removePostings(id, it->second);
+        }
+        addPostings(id, norm);
+        names[id] = std::move(norm);
+    }
+    void erase(int id) {
+        auto it = names.find(id);
+        if (it == names.end()) return;
+        removePostings(id, it->second);
+        names.erase(it);
+    }
+    void clear() { postings.clear(); names.clear(); }
+    size_t size() const { return names.size(); }
+
+    // matching ids, best match first (then shorter name, then id); limit 0 = all
+    vector<int> search(string_view query, Mode mode = SUBSTRING, size_t limit = 0) const {
+        string q = normalize(query);
+        if (q.empty()) return {};
+        string pattern = mode == PREFIX ? " " + q : q;
+
+        vector<int> candidates;
+        if (pattern.size() >= 3) {
+            vector<const pmr::vector<int>*> lists;
+            for (uint32_t k : trigramsOf(pattern)) {
+                auto p = postings.find(k);
+                if (p == postings.end()) return {};
+                lists.push_back(&p->second);
+            }
+            sort(lists.begin(), lists.end(), [](const pmr::vector<int> *a, const pmr::vector<int> *b) { return a->size() < b->size(); });
+            candidates.assign(lists[0]->begin(), lists[0]->end());
+            for (size_t l = 1; l < lists.size() && !candidates.empty(); ++l) {
+                const pmr::vector<int> &list = *lists[l];
+                auto from = list.begin();
+                size_t kept = 0;
+                for (int id : candidates) {
+                    from = lower_bound(from, list.end(), id);
+                    if (from == list.end()) break;
+                    if (*from == id) candidates[kept++] = id;
+                }
+                candidates.resize(kept);
+            }
+        } else {
+            for (auto &kv : names) candidates.push_back(kv.first); // one- or two-letter query
+        }
+
+        struct Hit { int rank; size_t length; int id; };
+        vector<Hit> hits;
+        for (int id : candidates) {
+            const string &name = names.at(id);
+            int rank = matchRank(name, q, mode);
+            if (rank >= 0) hits.push_back({rank, name.size(), id});
+        }
+        auto better = [](const Hit &a, const Hit &b) {
+            if (a.rank != b.rank) return a.rank < b.rank;
+            if (a.length != b.length) return a.length < b.length;
+            return a.id < b.id;
+        };
+        if (limit && hits.size() > limit) {
+            partial_sort(hits.begin(), hits.begin() + limit, hits.end(), better);
+            hits.resize(limit);
+        } else sort(hits.begin(), hits.end(), better);
+        vector<int> ids;
+        ids.reserve(hits.size());
+        for (auto &h : hits) ids.push_back(h.id);
+        return ids;
+    }
+};
+
+// --------------------------
+// Patient key indexes
+// --------------------------
+// Exact-match hash index from a normalized key to the patients that have
+// it, for duplicate checks at registration and front-desk lookups. Keys
+// are normalized both when stored and when looked up; a value that
+// normalizes to "" is not indexed.
+class KeyIndex {
+public:
+    using Normalizer = string (*)(string_view);
+private:
+    Normalizer normalize;
+    RecordPool mem;
+    pmr::unordered_map<string, pmr::vector<int>> byKey{mem.get()};
+    pmr::unordered_map<int, string> keys{mem.get()}; // id -> its key, to move it when the value changes
+
+    void drop(int id, const string &key) {
+        auto it = byKey.find(key);
+        if (it == byKey.end()) return;
+        auto &ids = it->second;
+        ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+        if (ids.empty()) byKey.erase(it);
+    }
+public:
+    KeyIndex(Normalizer n, bool pooled = POOLED_INDEXES) : normalize(n), mem(pooled) {}
+
+    void set(int id, string_view value) {
+        string key = normalize(value);
+        auto it = keys.find(id);
+        if (it != keys.end()) {
+            if (it->second == key) return;
+            drop(id, it->second);
+            keys.erase(it);
+        }
+        if (key.empty()) return;
+        byKey[key].push_back(id);
+        keys.emplace(id, std::move(key));
+    }
+    void clear() { byKey.clear(); keys.clear(); }
+
+    // ids stored under value's key, ascending
+    vector<int> find(string_view value) const {
+        auto it = byKey.find(normalize(value));
+        if (it == byKey.end()) return {};
+        vector<int> ids(it->second.begin(), it->second.end());
+        sort(ids.begin(), ids.end());
+        return ids;
+    }
+};
+
+// letters and digits only, upper case: "35201-1234567-1" == "3520112345671"
+string normalizeNationalId(string_view s) {
+    string out;
+    for (char c : s)
+        if (isalnum((unsigned char)c)) out += (char)toupper((unsigned char)c);
+    return out;
+}
+
+// The last ten digits, so "+92-300-1234567", "0300 1234567" and
+// "3001234567" agree. Fewer than seven digits is not a phone number.
+string normalizePhone(string_view s) {
+    string out;
+    for (char c : s)
+        if (isdigit((unsigned char)c)) out += c;
+    if (out.size() < 7) return "";
+    return out.size() > 10 ? out.substr(out.size() - 10) : out;
+}
+
+// --------------------------
+// Specialization index
+// --------------------------
+// Doctors by stemmed specialization word, so "Cardiology", "cardiologist"
+// and "CARDIOLOGY " all land on "cardiolog". A query word matches every
+// indexed stem it is a prefix of ("cardio" finds them too); a query with
+// several words needs all of them.
+static string stemWord(string w) {
+    static const pair<const char*, const char*> rules[] = {
+        {"ologists", "olog"}, {"ologist", "olog"}, {"ological", "olog"}, {"ology", "olog"},
+        {"icians", "ic"}, {"ician", "ic"}, {"ics", "ic"},
+        {"eons", ""}, {"eon", ""}, {"eries", ""}, {"ery", ""}, // surgeon, surgery -> surg
+        {"ists", ""}, {"ist", ""}, {"y", ""}, {"s", ""},       // psychiatrist, psychiatry -> psychiatr
+    };
+    for (auto &r : rules) {
+        size_t n = strlen(r.first);
+        if (w.size() > n + 2 && w.compare(w.size() - n, n, r.first) == 0) { w.replace(w.size() - n, n, r.second); break; }
+    }
+    return w;
+}
+
+// lowercased, stemmed, distinct words of text
+static vector<string> stemWords(string_view text) {
+    vector<string> words;
+    string cur;
+    for (size_t i = 0; i <= text.size(); ++i) {
+        if (i < text.size() && isalnum((unsigned char)text[i])) { cur.push_back((char)tolower((unsigned char)text[i])); continue; }
+        if (!cur.empty()) words.push_back(stemWord(cur));
+        cur.clear();
+    }
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+    return words;
+}
+
+class SpecializationIndex {
+private:
+    map<string, std::set<int>> byStem; // std:: because set() below hides it
+    map<int, vector<string>> stemsOf;
+public:
+    void set(int id, string_view spec) {
+        vector<string> stems = stemWords(spec);
+        auto it = stemsOf.find(id);
+        if (it != stemsOf.end()) {
+            if (it->second == stems) return;
+            erase(id);
+        }
+        for (auto &s : stems) byStem[s].insert(id);
+        stemsOf[id] = std::move(stems);
+    }
+    void erase(int id) {
+        auto it = stemsOf.find(id);
+        if (it == stemsOf.end()) return;
+        for (auto &s : it->second) {
+            auto b = byStem.find(s);
+            if (b == byStem.end()) continue;
+            b->second.erase(id);
+            if (b->second.empty()) byStem.erase(b);
+        }
+        stemsOf.erase(it);
+    }
+    void clear() { byStem.clear(); stemsOf.clear(); }
+
+    // ids whose specialization matches every word of query, ascending
+    vector<int> match(string_view query) const {
+        vector<int> result;
+        bool first = true;
+        for (auto &w : stemWords(query)) {
+            vector<int> ids;
+            for (auto it = byStem.lower_bound(w); it != byStem.end() && it->first.compare(0, w.size(), w) == 0; ++it)
+                ids.insert(ids.end(), it->second.begin(), it->second.end());
+            sort(ids.begin(), ids.end());
+            ids.erase(unique(ids.begin(), ids.end()), ids.end());
+            if (first) result.swap(ids);
+            else {
+                vector<int> both;
+                set_intersection(result.begin(), result.end(), ids.begin(), ids.end(), back_inserter(both));
+                result.swap(both);
+            }
+            first = false;
+            if (result.empty()) break;
+        }
+        return result;
+    }
+};
+
+// --------------------------
+// Duplicate detection
+// --------------------------
+// Offline pass for records whose names differ only by case, spacing or a
+// few typos ("Akbar Ali" / "Akbar ali"). Records are blocked by age plus
+// the Soundex code of every name word, so only names that sound alike are
+// compared, and each pair in a block is scored with a bit-parallel edit
+// distance. Blocks are spread over a TaskPool. A typo that changes how a
+// word sounds (or its first letter), or a different age, puts the pair in
+// different blocks and it is not reported.
+static const double DEDUP_MIN_SIMILARITY = 0.85; // 1 - distance / longer name
+static const size_t DEDUP_FULL_BLOCK = 2000;      // larger blocks only compare sorted neighbours
+static const size_t DEDUP_WINDOW = 64;            // how many neighbours, in that case
+static const string MERGE_CANDIDATES_FILE = "merge_candidates.txt"; // table,keepId,duplicateId,distance,keepName,duplicateName
+
+struct DedupRecord {
+    int id;
+    string name;
+    int age;
+};
+struct MergeCandidate {
+    int keepId;      // the older (lower) id
+    int duplicateId;
+    int distance;    // edits between the normalized names
+    double similarity;
+};
+
+// American Soundex of one word: first letter and three digits ("Robert" -> R163)
+string soundex(string_view word) {
+    static const char codes[] = "01230120022455012623010202"; // a..z
+    string out;
+    char last = 0;
+    for (char ch : word) {
+        if (!isalpha((unsigned char)ch)) continue;
+        char c = (char)tolower((unsigned char)ch);
+        char code = codes[c - 'a'];
+        if (out.empty()) out.push_back((char)toupper((unsigned char)c));
+        else if (code != '0' && code != last) out.push_back(code);
+        if (out.size() == 4) break;
+        if (c != 'h' && c != 'w') last = code; // h and w do not separate equal codes
+    }
+    if (out.empty()) return out;
+    out.resize(4, '0');
+    return out;
+}
+
+// plain dynamic-programming edit distance, for names too long for one word
+int levenshtein(string_view a, string_view b) {
+    vector<int> row(b.size() + 1);
+    iota(row.begin(), row.end(), 0);
+    for (size_t i = 1; i <= a.size(); ++i) {
+        int diag = row[0];
+        row[0] = (int)i;
+        for (size_t j = 1; j <= b.size(); ++j) {
+            int up = row[j];
+            row[j] = min({row[j] + 1, row[j - 1] + 1, diag + (a[i - 1] != b[j - 1])});
+            diag = up;
+        }
+    }
+    return row[b.size()];
+}
+
+// Edit distance from one pattern to many texts. For patterns of up to 64
+// bytes each column of the DP matrix is one 64-bit word (Myers' algorithm
+// as written by Hyyro), so a text costs a few word operations per byte.
+class EditDistancePattern {
+private:
+    uint64_t peq[256]; // bit i set where pattern[i] == c
+    string_view pattern;
+public:
+    explicit EditDistancePattern(string_view p) : pattern(p) {
+        memset(peq, 0, sizeof(peq));
+        if (p.size() <= 64)
+            for (size_t i = 0; i < p.size(); ++i) peq[(unsigned char)p[i]] |= 1ULL << i;
+    }
+    int distance(string_view text) const {
+        size_t m = pattern.size();
+        if (m == 0) return (int)text.size();
+        if (m > 64) return levenshtein(pattern, text);
+        uint64_t vp = ~0ULL, vn = 0, top = 1ULL << (m - 1);
+        int dist = (int)m;
+        for (char ch : text) {
+            uint64_t x = peq[(unsigned char)ch] | vn;
+            uint64_t d0 = (((x & vp) + vp) ^ vp) | x;
+            uint64_t hp = vn | ~(d0 | vp);
+            uint64_t hn = d0 & vp;
+            if (hp & top) ++dist;
+            else if (hn & top) --dist;
+            hp = (hp << 1) | 1;
+            hn <<= 1;
+            vp = hn | ~(d0 | hp);
+            vn = hp & d0;
+        }
+        return dist;
+    }
+};
+
+// every pair in records whose names are within DEDUP_MIN_SIMILARITY,
+// ordered by keepId then duplicateId; threads = 0 uses every core
+vector<MergeCandidate> findMergeCandidates(const vector<DedupRecord> &records, size_t threads = 0) {
+    size_t n = records.size();
+    if (n < 2) return {};
+    if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+    TaskPool pool(threads);
+
+    // normalized names and block keys
+    vector<string> names(n);
+    vector<pair<uint64_t, uint32_t>> order(n); // (block key hash, record)
+    size_t step = (n + threads - 1) / threads;
+    for (size_t from = 0; from < n; from += step) {
+        pool.submit([&, from] {
+            string key;
+            for (size_t i = from; i < min(n, from + step); ++i) {
+                names[i] = TrigramIndex::normalize(records[i].name);
+                key = to_string(records[i].age);
+                for (size_t at = 0; at < names[i].size();) {
+                    size_t end = names[i].find(' ', at);
+                    if (end == string::npos) end = names[i].size();
+                    key += '|';
+                    key += soundex(string_view(names[i]).substr(at, end - at));
+                    at = end + 1;
+                }
+                order[i] = {std::hash<string>()(key), (uint32_t)i};
+            }
+        });
+    }
+    pool.wait();
+    sort(order.begin(), order.end());
+
+    // blocks are runs of equal keys; a hash collision only merges two blocks
+    vector<pair<size_t, size_t>> blocks;
+    for (size_t b = 0, e; b < n; b = e) {
+        for (e = b + 1; e < n && order[e].first == order[b].first; ++e) {}
+        if (e - b > 1) blocks.push_back({b, e});
+    }
+
+    auto compare = [&](uint32_t a, uint32_t b, const EditDistancePattern &pa, vector<MergeCandidate> &out) {
+        size_t la = names[a].size(), lb = names[b].size(), longer = max(la, lb);
+        int allowed = (int)lround((1.0 - DEDUP_MIN_SIMILARITY) * longer);
+        if ((int)(la > lb ? la - lb : lb - la) > allowed) return;
+        int d = pa.distance(names[b]);
+        if (d > allowed) return;
+        int ida = records[a].id, idb = records[b].id;
+        out.push_back({min(ida, idb), max(ida, idb), d, longer ? 1.0 - (double)d / longer : 1.0});
+    };
+
+    // about threads * 4 batches of blocks, each with its own result list
+    size_t perBatch = max<size_t>(1, n / (threads * 4));
+    vector<vector<MergeCandidate>> results;
+    vector<pair<size_t, size_t>> batches; // ranges of blocks
+    for (size_t b = 0; b < blocks.size();) {
+        size_t e = b, rows = 0;
+        while (e < blocks.size() && rows < perBatch) { rows += blocks[e].second - blocks[e].first; ++e; }
+        batches.push_back({b, e});
+        b = e;
+    }
+    results.resize(batches.size());
+    for (size_t t = 0; t < batches.size(); ++t) {
+        pool.submit([&, t] {
+            vector<uint32_t> members;
+            for (size_t k = batches[t].first; k < batches[t].second; ++k) {
+                members.clear();
+                for (size_t i = blocks[k].first; i < blocks[k].second; ++i) members.push_back(order[i].second);
+                size_t window = members.size();
+                if (members.size() > DEDUP_FULL_BLOCK) {
+                    sort(members.begin(), members.end(), [&](uint32_t a, uint32_t b) { return names[a] < names[b]; });
+                    window = DEDUP_WINDOW;
+                }
+                for (size_t i = 0; i < members.size(); ++i) {
+                    EditDistancePattern pattern(names[members[i]]);
+                    for (size_t j = i + 1; j < members.size() && j <= i + window; ++j)
+                        compare(members[i], members[j], pattern, results[t]);
+                }
+            }
+        });
+    }
+    pool.wait();
+
+    vector<MergeCandidate> all;
+    for (auto &r : results) all.insert(all.end(), r.begin(), r.end());
+    sort(all.begin(), all.end(), [](const MergeCandidate &a, const MergeCandidate &b) {
+        return a.keepId != b.keepId ? a.keepId < b.keepId : a.duplicateId < b.duplicateId;
+    });
+    return all;
+}
+
+// --------------------------
+// Record tables
+// --------------------------
+// Records by id. Rows are filled front to back in fixed-size chunks and
+// never move, so a scan walks memory in order and pointers into a table
+// (QueryView) stay good while rows are added. A paged id -> row table
+// makes a lookup two array reads; ids are handed out in sequence, so the
+// pages stay dense. Erasing leaves a tombstone: the id keeps its row for
+// when it comes back, and the row's version changes so an old Handle no
+// longer resolves. Iteration is in id order and entries expose
+// first/second, so loops read the same as over the map<int, T> this
+// replaced.
+template <typename T>
+class SlotMap {
+public:
+    struct Slot {
+        int first = 0; // id
+        T second{};
+        uint32_t version = 0; // bumped by erase
+        bool live = false;
+    };
+    // a reference to one record that notices when the record is erased
+    struct Handle {
+        uint32_t row = UINT32_MAX;
+        uint32_t version = 0;
+    };
+
+private:
+    static const uint32_t NO_ROW = UINT32_MAX;
+    static const size_t CHUNK = 1024; // rows per chunk, ids per page
+
+    vector<unique_ptr<Slot[]>> chunks;
+    vector<unique_ptr<uint32_t[]>> pages; // id -> row + 1, 0 = never stored
+    map<int, uint32_t> negatives; // ids below zero only come from damaged files
+    uint32_t rowCount = 0, liveCount = 0;
+
+    Slot& slot(uint32_t r) const { return chunks[r / CHUNK][r % CHUNK]; }
+
+    uint32_t rowOf(int id) const {
+        if (id < 0) { auto it = negatives.find(id); return it == negatives.end() ? NO_ROW : it->second; }
+        size_t p = (size_t)id / CHUNK;
+        if (p >= pages.size() || !pages[p]) return NO_ROW;
+        return pages[p][id % CHUNK] - 1; // 0 wraps to NO_ROW
+    }
+
+    uint32_t newRow(int id) {
+        if (rowCount % CHUNK == 0) chunks.emplace_back(new Slot[CHUNK]);
+        uint32_t r = rowCount++;
+        slot(r).first = id;
+        if (id < 0) { negatives[id] = r; return r; }
+        size_t p = (size_t)id / CHUNK;
+        if (p >= pages.size()) pages.resize(p + 1);
+        if (!pages[p]) pages[p].reset(new uint32_t[CHUNK]());
+        pages[p][id % CHUNK] = r + 1;
+        return r;
+    }
+
+    void kill(uint32_t r) {
+        Slot &s = slot(r);
+        s.live = false;
+        s.second = T();
+        ++s.version;
+        --liveCount;
+    }
+
+public:
+    template <bool Const>
+    class Iter {
+    private:
+        friend class SlotMap;
+        using Owner = typename conditional<Const, const SlotMap, SlotMap>::type;
+        Owner *m = nullptr;
+        map<int, uint32_t>::const_iterator neg; // negatives first, then pages
+        size_t pos = 0; // next id to look at once negatives are done
+        uint32_t row = NO_ROW;
+
+        // moves to the first live row at or after the current position
+        void settle() {
+            for (; neg != m->negatives.end(); ++neg)
+                if (m->slot(neg->second).live) { row = neg->second; return; }
+            size_t limit = m->pages.size() * CHUNK;
+            while (pos < limit) {
+                const uint32_t *page = m->pages[pos / CHUNK].get();
+                if (!page) { pos = (pos / CHUNK + 1) * CHUNK; continue; }
+                uint32_t e = page[pos % CHUNK];
+                if (e && m->slot(e - 1).live) { row = e - 1; return; }
+                ++pos;
+            }
+            row = NO_ROW;
+        }
+
+    public:
+        using Ref = typename conditional<Const, const Slot&, Slot&>::type;
+        using Ptr = typename conditional<Const, const Slot*, Slot*>::type;
+
+        Iter() {}
+        Iter(Owner *m_, bool atEnd) : m(m_), neg(atEnd ? m_->negatives.end() : m_->negatives.begin()),
+                                      pos(atEnd ? m_->pages.size() * CHUNK : 0) { if (!atEnd) settle(); }
+        Iter(Owner *m_, int id, uint32_t r) : m(m_), neg(id < 0 ? m_->negatives.find(id) : m_->negatives.end()),
+                                              pos(id < 0 ? 0 : (size_t)id), row(r) {}
+        // iterator -> const_iterator
+        template <bool C = Const, typename = typename enable_if<C>::type>
+        Iter(const Iter<false> &o) : m(o.m), neg(o.neg), pos(o.pos), row(o.row) {}
+
+        Ref operator*() const { return m->slot(row); }
+        Ptr operator->() const { return &m->slot(row); }
+        Iter& operator++() {
+            if (neg != m->negatives.end()) ++neg; else ++pos;
+            settle();
+            return *this;
+        }
+        bool operator==(const Iter &o) const { return row == o.row; }
+        bool operator!=(const Iter &o) const { return row != o.row; }
+    };
+    using iterator = Iter<false>;
+    using const_iterator = Iter<true>;
+
+    SlotMap() {}
+    SlotMap(SlotMap &&) = default;
+    SlotMap& operator=(SlotMap &&) = default;
+    // copies only the live rows, so the copy has no tombstones
+    SlotMap(const SlotMap &o) { for (auto &kv : o) (*this)[kv.first] = kv.second; }
+    SlotMap& operator=(const SlotMap &o) {
+        if (this != &o) { SlotMap copy(o); *this = std::move(copy); }
+        return *this;
+    }
+
+    size_t size() const { return liveCount; }
+    bool empty() const { return liveCount == 0; }
+    size_t count(int id) const { uint32_t r = rowOf(id); return r != NO_ROW && slot(r).live ? 1 : 0; }
+
+    // inserts a default record if id is absent, like map::operator[]
+    T& operator[](int id) {
+        uint32_t r = rowOf(id);
+        if (r == NO_ROW) r = newRow(id);
+        Slot &s = slot(r);
+        if (!s.live) { s.live = true; ++liveCount; }
+        return s.second;
+    }
+    T& at(int id) {
+        uint32_t r = rowOf(id);
+        if (r == NO_ROW || !slot(r).live) throw out_of_range("no record with id " + to_string(id));
+        return slot(r).second;
+    }
+    const T& at(int id) const { return const_cast<SlotMap*>(this)->at(id); }
+
+    iterator find(int id) {
+        uint32_t r = rowOf(id);
+        return r != NO_ROW && slot(r).live ? iterator(this, id, r) : end();
+    }
+    const_iterator find(int id) const {
+        uint32_t r = rowOf(id);
+        return r != NO_ROW && slot(r).live ? const_iterator(this, id, r) : end();
+    }
+    iterator begin() { return iterator(this, false); }
+    iterator end() { return iterator(this, true); }
+    const_iterator begin() const { return const_iterator(this, false); }
+    const_iterator end() const { return const_iterator(this, true); }
+
+    size_t erase(int id) {
+        uint32_t r = rowOf(id);
+        if (r == NO_ROW || !slot(r).live) return 0;
+        kill(r);
+        return 1;
+    }
+    void erase(const_iterator it) { kill(it.row); }
+    void clear() {
+        chunks.clear(); pages.clear(); negatives.clear();
+        rowCount = liveCount = 0;
+    }
+
+    Handle handle(int id) const {
+        uint32_t r = rowOf(id);
+        if (r == NO_ROW || !slot(r).live) return Handle();
+        return Handle{r, slot(r).version};
+    }
+    // the record behind h, or nullptr once it has been erased
+    T* get(Handle h) {
+        if (h.row >= rowCount) return nullptr;
+        Slot &s = slot(h.row);
+        return s.live && s.version == h.version ? &s.second : nullptr;
+    }
+    const T* get(Handle h) const { return const_cast<SlotMap*>(this)->get(h); }
+};
+
+// --------------------------
+// Column store
+// --------------------------
+// Struct-of-arrays mirrors of the fields that statistics and reports scan.
+// Each column is one contiguous array and strings are stored as Symbol
+// codes, so a filter or a count is a branch-free loop over a few bytes per
+// row that the compiler can vectorize. Rows are in no particular order:
+// erase moves the last row into the hole. The database updates a mirror
+// wherever it updates the table behind it.
+
+class PatientColumns {
+private:
+    unordered_map<int, uint32_t> rowOf; // patient id -> row
+    vector<int32_t> ids, ages;
+    vector<uint8_t> insured;
+    vector<uint32_t> genders, providers; // Symbol codes
+public:
+    size_t size() const { return ids.size(); }
+    void clear() {
+        rowOf.clear(); ids.clear(); ages.clear(); insured.clear(); genders.clear(); providers.clear();
+    }
+    void set(const Patient &p) {
+        auto found = rowOf.find(p.getId());
+        uint32_t r;
+        if (found != rowOf.end()) r = found->second;
+        else {
+            r = (uint32_t)ids.size();
+            rowOf.emplace(p.getId(), r);
+            ids.push_back(p.getId()); ages.push_back(0); insured.push_back(0); genders.push_back(0); providers.push_back(0);
+        }
+        ages[r] = p.getAge();
+        insured[r] = p.isInsured() ? 1 : 0;
+        genders[r] = p.getGender().code();
+        providers[r] = p.isInsured() ? p.getInsuranceProvider().code() : 0;
+    }
+
+    // insured patients with minAge <= age <= maxAge, per provider
+    vector<pair<string, uint64_t>> insuredByProvider(int minAge, int maxAge) const {
+        if (minAge > maxAge) return {};
+        vector<uint64_t> counts(SymbolTable::global().size());
+        uint32_t span = (uint32_t)maxAge - (uint32_t)minAge;
+        const int32_t *age = ages.data();
+        const uint8_t *ins = insured.data();
+        const uint32_t *prov = providers.data();
+        for (size_t i = 0, n = ids.size(); i < n; ++i)
+            counts[prov[i]] += ins[i] & ((uint32_t)age[i] - (uint32_t)minAge <= span);
+        vector<pair<string, uint64_t>> out;
+        for (uint32_t c = 0; c < counts.size(); ++c)
+            if (counts[c]) out.push_back({SymbolTable::global().text(c), counts[c]});
+        return out;
+    }
+    size_t countAgedBetween(int minAge, int maxAge) const {
+        if (minAge > maxAge) return 0; // an inverted range would wrap the span below
+        uint32_t span = (uint32_t)maxAge - (uint32_t)minAge;
+        size_t count = 0;
+        const int32_t *age = ages.data();
+        for (size_t i = 0, n = ids.size(); i < n; ++i) count += (uint32_t)age[i] - (uint32_t)minAge <= span;
+        return count;
+    }
+    // patients per gender as entered
+    vector<pair<string, uint64_t>> countByGender() const {
+        vector<uint64_t> counts(SymbolTable::global().size());
+        for (uint32_t g : genders) ++counts[g];
+        vector<pair<string, uint64_t>> out;
+        for (uint32_t c = 0; c < counts.size(); ++c)
+            if (counts[c]) out.push_back({SymbolTable::global().text(c), counts[c]});
+        return out;
+    }
+};
+
+class AppointmentColumns {
+private:
+    unordered_map<int, uint32_t> rowOf; // appointment id -> row
+    vector<int32_t> ids, patientIds;
+    vector<uint32_t> doctors; // codes into doctorIds
+    vector<int64_t> times;    // Timestamp seconds
+    vector<int> doctorIds;    // code -> doctor id
+    unordered_map<int, uint32_t> doctorCodes;
+
+    uint32_t doctorCode(int did) {
+        auto it = doctorCodes.find(did);
+        if (it != doctorCodes.end()) return it->second;
+        doctorCodes.emplace(did, (uint32_t)doctorIds.size());
+        doctorIds.push_back(did);
+        return (uint32_t)doctorIds.size() - 1;
+    }
+public:
+    size_t size() const { return ids.size(); }
+    void clear() {
+        rowOf.clear(); ids.clear(); patientIds.clear(); doctors.clear(); times.clear();
+        doctorIds.clear(); doctorCodes.clear();
+    }
+    void set(const Appointment &a) {
+        auto found = rowOf.find(a.id);
+        uint32_t r;
+        if (found != rowOf.end()) r = found->second;
+        else {
+            r = (uint32_t)ids.size();
+            rowOf.emplace(a.id, r);
+            ids.push_back(a.id); patientIds.push_back(0); doctors.push_back(0); times.push_back(0);
+        }
+        patientIds[r] = a.patientId;
+        doctors[r] = doctorCode(a.doctorId);
+        times[r] = a.datetime.seconds();
+    }
+    void erase(int id) {
+        auto found = rowOf.find(id);
+        if (found == rowOf.end()) return;
+        uint32_t r = found->second, last = (uint32_t)ids.size() - 1;
+        rowOf.erase(found);
+        if (r != last) {
+            ids[r] = ids[last]; patientIds[r] = patientIds[last]; doctors[r] = doctors[last]; times[r] = times[last];
+            rowOf[ids[r]] = r;
+        }
+        ids.pop_back(); patientIds.pop_back(); doctors.pop_back(); times.pop_back();
+    }
+
+    // appointments with from <= time < to
+    size_t countBetween(Timestamp from, Timestamp to) const {
+        int64_t lo = from.seconds(), hi = to.seconds();
+        size_t count = 0;
+        const int64_t *t = times.data();
+        for (size_t i = 0, n = times.size(); i < n; ++i) count += (t[i] >= lo) & (t[i] < hi);
+        return count;
+    }
+    // (doctor id, appointments) for every doctor with one in [from, to)
+    vector<pair<int, uint64_t>> perDoctorBetween(Timestamp from, Timestamp to) const {
+        vector<uint64_t> counts(doctorIds.size());
+        int64_t lo = from.seconds(), hi = to.seconds();
+        const int64_t *t = times.data();
+        const uint32_t *doc = doctors.data();
+        for (size_t i = 0, n = times.size(); i < n; ++i) counts[doc[i]] += (t[i] >= lo) & (t[i] < hi);
+        vector<pair<int, uint64_t>> out;
+        for (uint32_t c = 0; c < counts.size(); ++c)
+            if (counts[c]) out.push_back({doctorIds[c], counts[c]});
+        return out;
+    }
+};
+
+// Bill totals in paisa. Revenue is an integer reduction over one array,
+// so it is exact, allocation-free and vectorizes; a bill's total is
+// refreshed whenever the bill changes. byPatient lists each patient's
+// bills, so one patient's view does not scan the whole table.
+class BillColumns {
+private:
+    unordered_map<int, uint32_t> rowOf; // bill id -> row
+    vector<int32_t> ids, patientIds;
+    vector<int64_t> totals;
+    map<int, std::set<int>> byPatient; // patient id -> bill ids (std:: because set() below is a member)
+public:
+    size_t size() const { return ids.size(); }
+    void clear() { rowOf.clear(); ids.clear(); patientIds.clear(); totals.clear(); byPatient.clear(); }
+    void set(const Bill &b) {
+        auto found = rowOf.find(b.billId);
+        uint32_t r;
+        if (found != rowOf.end()) {
+            r = found->second;
+            if (patientIds[r] != b.patientId) {
+                auto old = byPatient.find(patientIds[r]);
+                old->second.erase(b.billId);
+                if (old->second.empty()) byPatient.erase(old);
+            }
+        } else {
+            r = (uint32_t)ids.size();
+            rowOf.emplace(b.billId, r);
+            ids.push_back(b.billId); patientIds.push_back(0); totals.push_back(0);
+        }
+        patientIds[r] = b.patientId;
+        totals[r] = b.total().minor();
+        byPatient[b.patientId].insert(b.billId);
+    }
+
+    // f(billId) for each of the patient's bills, by id
+    template <typename F>
+    void forEachBillOf(int pid, F f) const {
+        auto it = byPatient.find(pid);
+        if (it == byPatient.end()) return;
+        for (int id : it->second) f(id);
+    }
+
+    Money revenue() const {
+        int64_t sum = 0;
+        const int64_t *t = totals.data();
+        for (size_t i = 0, n = totals.size(); i < n; ++i) sum += t[i];
+        return Money::fromMinor(sum);
+    }
+    Money revenueForPatient(int pid) const {
+        int64_t sum = 0;
+        const int64_t *t = totals.data();
+        const int32_t *p = patientIds.data();
+        for (size_t i = 0, n = totals.size(); i < n; ++i) sum += t[i] & -(int64_t)(p[i] == pid);
+        return Money::fromMinor(sum);
+    }
+};
+
+// --------------------------
+// Query views
+// --------------------------
+// A query result as pointers into the database's own tables; no row is
+// copied. Lifetime: a view stays good until the next change to the table
+// it came from (add, edit*, cancel, addBillItem, ...) and never outlives
+// the database. It keeps the table's change counter from when it was made
+// and throws rather than read rows that may have moved or gone.
+template <typename T>
+class QueryView {
+private:
+    vector<const T*> rows;
+    const unsigned long *generation; // the table's change counter
+    unsigned long expected;
+
+    void check() const {
+        if (*generation != expected) throw runtime_error("query result used after its table changed");
+    }
+public:
+    class iterator {
+    private:
+        typename vector<const T*>::const_iterator it;
+    public:
+        explicit iterator(typename vector<const T*>::const_iterator it_) : it(it_) {}
+        const T& operator*() const { return **it; }
+        const T* operator->() const { return *it; }
+        iterator& operator++() { ++it; return *this; }
+        bool operator==(const iterator &o) const { return it == o.it; }
+        bool operator!=(const iterator &o) const { return it != o.it; }
+    };
+
+    QueryView(vector<const T*> rows_, const unsigned long *generation_)
+        : rows(std::move(rows_)), generation(generation_), expected(*generation_) {}
+
+    bool valid() const { return *generation == expected; }
+    size_t size() const { return rows.size(); }
+    bool empty() const { return rows.empty(); }
+    iterator begin() const { check(); return iterator(rows.begin()); }
+    iterator end() const { return iterator(rows.end()); }
+    const T& operator[](size_t i) const { check(); return *rows[i]; }
+
+    // an owned copy, for results that must outlive the next change
+    vector<T> toVector() const {
+        check();
+        vector<T> out;
+        out.reserve(rows.size());
+        for (const T *row : rows) out.push_back(*row);
+        return out;
+    }
 };
 
+// --------------------------
+// Binary snapshot
+// --------------------------
+// shms.snap holds every table in one file so startup is a single mapped
+// read instead of a CSV parse. Layout (little-endian):
+//   header : "SHMSSNAP", version, section count, next ids, data-file
+//            fingerprint, header checksum
+//   section: tag, payload length, payload checksum, payload
+// Strings live in a pool section and records refer to them as
+// (offset,length). The CSV files stay the interchange format: the snapshot
+// is ignored when its fingerprint no longer matches them.
+static const char SNAPSHOT_MAGIC[8] = {'S','H','M','S','S','N','A','P'};
+static const uint32_t SNAPSHOT_VERSION = 6; // 2: doctor slots dropped, 3: timestamps as int64 seconds, 4: medical history moved to history.txt, 5: bill amounts as int64 paisa, 6: unparsed timestamp text kept
+enum SnapshotTag : uint32_t { SNAP_POOL = 1, SNAP_USERS, SNAP_PATIENTS, SNAP_DOCTORS, SNAP_STAFF, SNAP_APPOINTMENTS, SNAP_BILLS, SNAP_MEDICINES };
+
+// word-at-a-time hash, fast enough to check the whole file at load
+inline uint64_t checksum64(const char *p, size_t n, uint64_t h = 0x9E3779B97F4A7C15ULL) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w; memcpy(&w, p + i, 8);
+        h = (h ^ w) * 0x100000001B3ULL;
+        h ^= h >> 29;
+    }
+    for (; i < n; ++i) h = (h ^ (unsigned char)p[i]) * 0x100000001B3ULL;
+    return h ^ (h >> 32);
+}
 
+// sizes and modification times of the CSV files and the journal. Times
+// are taken at the file system's full resolution: whole seconds would miss
+// a same-size edit made in the second after a save.
+inline uint64_t dataFilesFingerprint() {
+    const string files[] = {USERS_FILE, PATIENTS_FILE, DOCTORS_FILE, STAFF_FILE, APPOINTMENTS_FILE, BILLS_FILE, MEDICINES_FILE, JOURNAL_FILE};
+    uint64_t h = 0;
+    for (auto &f : files) {
+        uint64_t st3[3] = {0, 0, 0}; // size, modification time, sub-second part
+#ifdef _WIN32
+        WIN32_FILE_ATTRIBUTE_DATA fa;
+        if (GetFileAttributesExA(f.c_str(), GetFileExInfoStandard, &fa)) {
+            st3[0] = ((uint64_t)fa.nFileSizeHigh << 32) | fa.nFileSizeLow;
+            st3[1] = ((uint64_t)fa.ftLastWriteTime.dwHighDateTime << 32) | fa.ftLastWriteTime.dwLowDateTime; // 100 ns ticks
+        }
+#else
+        struct stat st;
+        if (stat(f.c_str(), &st) == 0) {
+            st3[0] = (uint64_t)st.st_size;
+            st3[1] = (uint64_t)st.st_mtime;
+#ifdef __APPLE__
+            st3[2] = (uint64_t)st.st_mtimespec.tv_nsec;
+#else
+            st3[2] = (uint64_t)st.st_mtim.tv_nsec;
+#endif
+        }
+#endif
+        h = checksum64((const char*)st3, sizeof(st3), h);
+    }
+    return h;
+}
 
-struct Appointment {
-    int id;
-    int patientId;
-    int doctorId;
-    string datetime;
-    string type;
-    string reason;
-    Appointment() : id(0), patientId(0), doctorId(0) {}
-    vector<string> toCSV() const { return {to_string(id), to_string(patientId), to_string(doctorId), datetime, type, reason}; }
-    static Appointment fromCSV(const vector<string> &r) {
-        Appointment a;
-        if (r.size()>=1) a.id = toIntSafe(r[0],0);
-        if (r.size()>=2) a.patientId = toIntSafe(r[1],0);
-        if (r.size()>=3) a.doctorId = toIntSafe(r[2],0);
-        if (r.size()>=4) a.datetime = r[3];
-        if (r.size()>=5) a.type = r[4];
-        if (r.size()>=6) a.reason = r[5];
-        return a;
+class SnapshotWriter {
+private:
+    string pool;
+public:
+    string buf; // current section payload
+
+    void u8(uint8_t v) { buf.push_back((char)v); }
+    void u32(uint32_t v) { buf.append((const char*)&v, 4); }
+    void i32(int32_t v) { buf.append((const char*)&v, 4); }
+    void f64(double v) { buf.append((const char*)&v, 8); }
+    void i64(int64_t v) { buf.append((const char*)&v, 8); }
+    void str(const string &s) { u32((uint32_t)pool.size()); u32((uint32_t)s.size()); pool += s; }
+
+    // moves the current payload into a finished section
+    void endSection(uint32_t tag, string &sections) {
+        uint32_t hdr[2] = {tag, (uint32_t)buf.size()};
+        uint64_t sum = checksum64(buf.data(), buf.size());
+        sections.append((const char*)hdr, sizeof(hdr));
+        sections.append((const char*)&sum, 8);
+        sections += buf;
+        buf.clear();
     }
+    void endPool(string &sections) { buf.swap(pool); endSection(SNAP_POOL, sections); }
 };
 
-// --------------------------
-// User struct for login
-// --------------------------
-struct User {
-    string username;
-    string role;
-    string password;
-    int linkedId; // for patient or staff
-    vector<string> toCSV() const { return {username, role, password, to_string(linkedId)}; }
-    static User fromCSV(const vector<string> &r) {
-        User u;
-        if (r.size()>=1) u.username = r[0];
-        if (r.size()>=2) u.role = r[1];
-        if (r.size()>=3) u.password = r[2];
-        if (r.size()>=4) u.linkedId = toIntSafe(r[3],0);
-        return u;
+class SnapshotReader {
+private:
+    const char *p, *end;
+    string_view pool;
+public:
+    bool ok = true;
+    SnapshotReader(string_view payload, string_view pool_) : p(payload.data()), end(payload.data() + payload.size()), pool(pool_) {}
+
+    bool take(void *out, size_t n) {
+        if (!ok || (size_t)(end - p) < n) { ok = false; memset(out, 0, n); return false; }
+        memcpy(out, p, n); p += n; return true;
+    }
+    uint8_t u8() { uint8_t v; take(&v, 1); return v; }
+    uint32_t u32() { uint32_t v; take(&v, 4); return v; }
+    int32_t i32() { int32_t v; take(&v, 4); return v; }
+    double f64() { double v; take(&v, 8); return v; }
+    int64_t i64() { int64_t v; take(&v, 8); return v; }
+    string str() {
+        uint32_t off = u32(), len = u32();
+        if (!ok || (uint64_t)off + len > pool.size()) { ok = false; return string(); }
+        return string(pool.substr(off, len));
     }
 };
 
@@ -680,36 +3182,369 @@ struct User {
 // --------------------------
 class SHMSDatabase {
 private:
+    // one entry per base file, used for dirty tracking
+    enum Table { TBL_USERS, TBL_PATIENTS, TBL_DOCTORS, TBL_STAFF, TBL_APPOINTMENTS, TBL_BILLS, TBL_MEDICINES, TBL_COUNT };
+
     int nextPersonId = 1;
     int nextAppointmentId = 1;
     int nextBillId = 1;
 
    
-    map<int, Doctor> doctors;
-    map<int, Staff> staffs;
-    map<int, Appointment> appointments;
-    map<int, Bill> bills;
-    map<string, User> users;
+    SlotMap<Doctor> doctors;
+    SlotMap<Staff> staffs;
+    SlotMap<Appointment> appointments;
+    SlotMap<Bill> bills;
+    UserTable users;
 
     PharmacyService pharmacy;
     DiagnosticsService diagnostics;
     EmergencyService emergency;
     SurgeryService surgery;
 
+    PersistenceWriter writer; // declared before the journal, which feeds it
+    Journal journal{JOURNAL_FILE, writer};
+    bool closed = false;
+    bool snapshotCurrent = false; // shms.snap was loaded and still matches the files
+    bool compacted = false;       // compact() rewrote base files this session
+
+    vector<pair<string,double>> loadTimings; // table -> milliseconds, from the last loadAll()
+
+    bool lazyHistory;
+    LazyIndex lazyAppointments, lazyBills;
+
+    bool pooledIndexes; // initialized before the indexes below, which take it
+    AppointmentIndex apptsByPatient{pooledIndexes}, apptsByDoctor{pooledIndexes};
+
+    TrigramIndex patientNames{pooledIndexes};
+    KeyIndex nationalIds{normalizeNationalId, pooledIndexes}, phones{normalizePhone, pooledIndexes};
+    vector<int> pendingPatientChecks; // patients handed out by editPatient(); reindexed before the next lookup
+
+    PatientColumns patientColumns;
+    AppointmentColumns appointmentColumns;
+    BillColumns billColumns;
+    vector<int> pendingBillChecks; // bills handed out by editBill(); their totals are refreshed before a report
+
+    HistoryLog history{pooledIndexes};
+    CsvWriter historyLine{nullptr, 256}; // reused for every appended entry
+    map<int, string> legacyHistory; // old free-text column by patient, until adoptLegacyHistory()
+
+    SpecializationIndex specialties;
+    vector<int> pendingSpecChecks; // doctors handed out by editDoctor()
+
+    void indexSpecializations() {
+        specialties.clear();
+        for (auto &kv : doctors) specialties.set(kv.first, kv.second.getSpecialization().str());
+    }
+    void syncSpecializationEdits() {
+        for (int id : pendingSpecChecks) {
+            auto it = doctors.find(id);
+            if (it != doctors.end()) specialties.set(id, it->second.getSpecialization().str());
+        }
+        pendingSpecChecks.clear();
+    }
+
+    // name, national ID and phone indexes and the column mirror for one patient
+    void indexPatient(const Patient &p) {
+        patientColumns.set(p);
+        patientNames.set(p.getId(), p.getName());
+        nationalIds.set(p.getId(), p.getNationalId());
+        phones.set(p.getId(), p.getContact());
+    }
+    void indexPatients() {
+        patientNames.clear(); nationalIds.clear(); phones.clear(); patientColumns.clear();
+        for (auto &kv : patients) indexPatient(kv.second);
+    }
+    template <typename T>
+    static vector<DedupRecord> dedupRecords(const SlotMap<T> &rows) {
+        vector<DedupRecord> out;
+        out.reserve(rows.size());
+        for (auto &kv : rows) out.push_back({kv.first, kv.second.getName(), kv.second.getAge()});
+        return out;
+    }
+    void syncPatientEdits() {
+        for (int id : pendingPatientChecks) {
+            auto it = patients.find(id);
+            if (it != patients.end()) indexPatient(it->second);
+        }
+        pendingPatientChecks.clear();
+    }
+
+    // -------- appointment map updates (keep the lookup indexes and columns in step) --------
+    void putAppointment(Appointment a) {
+        auto it = appointments.find(a.id);
+        if (it != appointments.end()) unindexAppointment(it->second);
+        apptsByPatient.add(a.patientId, a.datetime, a.id);
+        apptsByDoctor.add(a.doctorId, a.datetime, a.id);
+        appointmentColumns.set(a);
+        appointments[a.id] = std::move(a);
+    }
+    void unindexAppointment(const Appointment &a) {
+        apptsByPatient.remove(a.patientId, a.datetime, a.id);
+        apptsByDoctor.remove(a.doctorId, a.datetime, a.id);
+    }
+    void eraseAppointment(int id) {
+        auto it = appointments.find(id);
+        if (it == appointments.end()) return;
+        unindexAppointment(it->second);
+        appointmentColumns.erase(id);
+        appointments.erase(it);
+    }
+    // -------- bill map updates (keep the totals column in step) --------
+    void putBill(Bill b) {
+        billColumns.set(b);
+        bills[b.billId] = std::move(b);
+    }
+    void clearBills() {
+        bills.clear();
+        billColumns.clear();
+        pendingBillChecks.clear();
+    }
+    void syncBillEdits() {
+        for (int id : pendingBillChecks) {
+            auto it = bills.find(id);
+            if (it != bills.end()) billColumns.set(it->second);
+        }
+        pendingBillChecks.clear();
+    }
+
+    void clearAppointments() {
+        appointments.clear();
+        apptsByPatient.clear();
+        apptsByDoctor.clear();
+        appointmentColumns.clear();
+    }
+
+    // -------- doctor calendars (derived from appointments) --------
+    // unknown doctors and unparsable times simply book nothing
+    void bookDoctorSlot(const Appointment &a) {
+        auto it = doctors.find(a.doctorId);
+        if (it != doctors.end() && a.datetime.valid()) it->second.bookSlot(a.datetime.minutes(), a.id);
+    }
+    void releaseDoctorSlot(const Appointment &a) {
+        auto it = doctors.find(a.doctorId);
+        if (it != doctors.end() && a.datetime.valid()) it->second.releaseSlot(a.datetime.minutes(), a.id);
+    }
+    // after a doctor row is replaced wholesale
+    void relinkDoctorSlots(int doctorId) {
+        apptsByDoctor.forEach(doctorId, [&](int id) { bookDoctorSlot(appointments.at(id)); });
+    }
+
+    // next ids from what is loaded (maxId is still 0 for a lazy table whose
+    // index has not been built; ensure*Index() raises them when it is)
+    void recountAppointmentIds() {
+        nextAppointmentId = lazyAppointments.maxId + 1;
+        for (auto &kv : appointments) nextAppointmentId = max(nextAppointmentId, kv.first + 1);
+    }
+    void recountBillIds() {
+        nextBillId = lazyBills.maxId + 1;
+        for (auto &kv : bills) nextBillId = max(nextBillId, kv.first + 1);
+    }
+
+    // -------- lazy history helpers (no-ops once a table is fully loaded) --------
+    void ensureAppointmentIndex() {
+        if (!lazyAppointments.enabled || lazyAppointments.built) return;
+        lazyAppointments.build(APPOINTMENTS_FILE, true);
+        nextAppointmentId = max(nextAppointmentId, lazyAppointments.maxId + 1);
+    }
+    void ensureBillIndex() {
+        if (!lazyBills.enabled || lazyBills.built) return;
+        lazyBills.build(BILLS_FILE, false);
+        nextBillId = max(nextBillId, lazyBills.maxId + 1);
+    }
+    void materializeAppointment(LazyRow &r) {
+        if (r.taken) return;
+        r.taken = true;
+        if (appointments.count(r.id)) return; // newer in-memory version wins
+        lazyAppointments.parse(r, [&](const string_view *f, size_t n) {
+            Appointment a = Appointment::fromFields(f, n);
+            bookDoctorSlot(a);
+            putAppointment(std::move(a));
+        });
+    }
+    void materializeBill(LazyRow &r) {
+        if (r.taken) return;
+        r.taken = true;
+        if (bills.count(r.id)) return;
+        lazyBills.parse(r, [&](const string_view *f, size_t n) {
+            putBill(Bill::fromFields(f, n));
+        });
+    }
+    // make sure the file version of one id (if any) is in the map
+    void loadAppointmentId(int id) {
+        if (!lazyAppointments.enabled) return;
+        ensureAppointmentIndex();
+        if (LazyRow *r = lazyAppointments.find(id)) materializeAppointment(*r);
+    }
+    void loadBillId(int id) {
+        if (!lazyBills.enabled) return;
+        ensureBillIndex();
+        if (LazyRow *r = lazyBills.find(id)) materializeBill(*r);
+    }
+    template <typename Pred>
+    void loadAppointmentsWhere(Pred keep) {
+        if (!lazyAppointments.enabled) return;
+        ensureAppointmentIndex();
+        for (auto &r : lazyAppointments.rows) if (!r.taken && keep(r)) materializeAppointment(r);
+    }
+    void loadAppointmentsOfPatient(int pid) {
+        if (!lazyAppointments.enabled) return;
+        ensureAppointmentIndex();
+        lazyAppointments.forEachRowOf(lazyAppointments.byPatient, pid, [&](LazyRow &r) { materializeAppointment(r); });
+    }
+    void loadAppointmentsOfDoctor(int did) {
+        if (!lazyAppointments.enabled) return;
+        ensureAppointmentIndex();
+        lazyAppointments.forEachRowOf(lazyAppointments.byDoctor, did, [&](LazyRow &r) { materializeAppointment(r); });
+    }
+    void loadBillsOfPatient(int pid) {
+        if (!lazyBills.enabled) return;
+        ensureBillIndex();
+        lazyBills.forEachRowOf(lazyBills.byPatient, pid, [&](LazyRow &r) { materializeBill(r); });
+    }
+    template <typename Pred>
+    void loadBillsWhere(Pred keep) {
+        if (!lazyBills.enabled) return;
+        ensureBillIndex();
+        for (auto &r : lazyBills.rows) if (!r.taken && keep(r)) materializeBill(r);
+    }
+    // full-table operations (listing, statistics, rewriting the file)
+    void ensureAllAppointments() {
+        if (!lazyAppointments.enabled) return;
+        loadAppointmentsWhere([](const LazyRow&) { return true; });
+        lazyAppointments.release();
+    }
+    void ensureAllBills() {
+        if (!lazyBills.enabled) return;
+        loadBillsWhere([](const LazyRow&) { return true; });
+        lazyBills.release();
+    }
+
+    // changeGen is bumped by every mutation, savedGen is the value the base
+    // file was last written at; compact() skips tables where they match.
+    unsigned long changeGen[TBL_COUNT] = {};
+    unsigned long savedGen[TBL_COUNT] = {};
+
+    // rows handed out through edit*() pointers; journaled on the next save
+    vector<pair<Table,int>> rawEdits;
+
+    void touch(Table t) { ++changeGen[t]; }
+    template <typename Rec>
+    void record(Table t, char op, const Rec &rec) {
+        touch(t);
+        journal.append(op, rec);
+    }
+    void record(Table t, char op, const vector<string> &row) {
+        touch(t);
+        journal.append(op, row);
+    }
+
+    // journal the current state of every row edited through a raw pointer
+    void flushRawEdits() {
+        for (auto &e : rawEdits) {
+            int id = e.second;
+            if (e.first == TBL_PATIENTS && patients.count(id)) journal.append('P', patients[id]);
+            else if (e.first == TBL_DOCTORS && doctors.count(id)) journal.append('D', doctors[id]);
+            else if (e.first == TBL_STAFF && staffs.count(id)) journal.append('S', staffs[id]);
+            else if (e.first == TBL_BILLS && bills.count(id)) journal.append('B', bills[id]);
+        }
+        rawEdits.clear();
+    }
+
+    // apply one journal record; every case is an upsert or an erase
+    // (replayed tables are dirty: their base file is older than the journal)
+    void applyJournalRecord(char op, const string_view *r, size_t n) {
+        if (op == 'U') { User u = User::fromFields(r, n); users[u.username] = u; touch(TBL_USERS); }
+        else if (op == 'P') {
+            Patient p = Patient::fromFields(r, n);
+            if (n >= 9 && !r[8].empty()) legacyHistory[p.getId()] = string(r[8]);
+            indexPatient(p); patients[p.getId()] = p; touch(TBL_PATIENTS);
+        }
+        else if (op == 'D') { Doctor d = Doctor::fromFields(r, n); specialties.set(d.getId(), d.getSpecialization().str()); doctors[d.getId()] = d; relinkDoctorSlots(d.getId()); touch(TBL_DOCTORS); }
+        else if (op == 'S') { Staff st = Staff::fromFields(r, n); staffs[st.getId()] = st; touch(TBL_STAFF); }
+        else if (op == 'A') {
+            Appointment a = Appointment::fromFields(r, n);
+            loadAppointmentId(a.id);
+            auto old = appointments.find(a.id);
+            if (old != appointments.end()) releaseDoctorSlot(old->second);
+            bookDoctorSlot(a);
+            putAppointment(a);
+            touch(TBL_APPOINTMENTS);
+        }
+        else if (op == 'X') { if (n > 0) cancelAppointment(parseIntView(r[0], 0), false); }
+        else if (op == 'B') { Bill b = Bill::fromFields(r, n); loadBillId(b.billId); putBill(std::move(b)); touch(TBL_BILLS); }
+        else if (op == 'M') {
+            if (n >= 3) { pharmacy.setMedicine(string(r[0]), parseIntView(r[1], 0), string(r[2])); touch(TBL_MEDICINES); }
+        }
+    }
+
+    void journalMedicine(const string &name) {
+        record(TBL_MEDICINES, 'M', {name, to_string(pharmacy.quantityOf(name)), pharmacy.expiryOf(name)});
+    }
+
 public:
-	 map<int, Patient> patients;
-    SHMSDatabase() { loadAll(); seedIfEmpty(); }
-    ~SHMSDatabase() { saveAll(); }
+	 SlotMap<Patient> patients;
+    // lazyHistory: bills and appointments are indexed on first use and only
+    // the rows a session asks for are parsed
+    // pooledIndexes: the lookup indexes and history log use their own pools
+    explicit SHMSDatabase(bool lazyHistory_ = LAZY_HISTORY, bool pooledIndexes_ = POOLED_INDEXES)
+        : lazyHistory(lazyHistory_), pooledIndexes(pooledIndexes_) { loadAll(); seedIfEmpty(); }
+    ~SHMSDatabase() { shutdown(); }
 
     // Persistence
     void loadAll() {
-        loadUsers();
-        loadPatients();
-        loadDoctors();
-        loadStaff();
-        loadAppointments();
-        loadBills();
-        pharmacy.loadFromFile(MEDICINES_FILE);
+        loadTimings.clear();
+        lazyAppointments = LazyIndex();
+        lazyBills = LazyIndex();
+        lazyAppointments.enabled = lazyBills.enabled = lazyHistory;
+        auto t0 = chrono::steady_clock::now();
+        snapshotCurrent = false;
+        if (SNAPSHOT_ENABLED && loadSnapshot()) {
+            snapshotCurrent = true;
+            loadTimings.push_back({"snapshot", chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count()});
+            // the snapshot has no history; it is read from its own file either way
+            auto historyStart = chrono::steady_clock::now();
+            loadHistory();
+            loadTimings.push_back({"history", chrono::duration<double, milli>(chrono::steady_clock::now() - historyStart).count()});
+            return;
+        }
+
+        // Every table lives in its own file and container, so they load in
+        // parallel; each task writes only its own timing slot.
+        const char *names[] = {"users", "patients", "doctors", "staff", "appointments", "bills", "medicines", "history"};
+        function<void()> loaders[] = {
+            [this] { loadUsers(); },
+            [this] { loadPatients(); },
+            [this] { loadDoctors(); },
+            [this] { loadStaff(); },
+            [this] { if (!lazyHistory) loadAppointments(); },
+            [this] { if (!lazyHistory) loadBills(); },
+            [this] { pharmacy.loadFromFile(MEDICINES_FILE); },
+            [this] { loadHistory(); },
+        };
+        const size_t tableCount = sizeof(loaders) / sizeof(loaders[0]);
+        vector<double> ms(tableCount);
+        {
+            TaskPool pool(min<size_t>(tableCount, max(1u, thread::hardware_concurrency())));
+            for (size_t i = 0; i < tableCount; ++i) {
+                pool.submit([&, i] {
+                    auto start = chrono::steady_clock::now();
+                    loaders[i]();
+                    ms[i] = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+                });
+            }
+            pool.wait();
+        }
+        for (size_t i = 0; i < tableCount; ++i) loadTimings.push_back({names[i], ms[i]});
+
+        // the only cross-table dependency: appointments book doctor slots
+        // (lazy rows link their slot when they are materialized)
+        auto linkStart = chrono::steady_clock::now();
+        if (!lazyHistory) linkDoctorSlots();
+        loadTimings.push_back({"slot linking", chrono::duration<double, milli>(chrono::steady_clock::now() - linkStart).count()});
+
+        // changes made since the last compaction
+        journal.replay([this](char op, const string_view *r, size_t n) { applyJournalRecord(op, r, n); });
+        adoptLegacyHistory();
 
         // set next ids
         nextPersonId = 1;
@@ -717,132 +3552,396 @@ public:
         for (auto &kv : doctors) nextPersonId = max(nextPersonId, kv.first + 1);
         for (auto &kv : staffs) nextPersonId = max(nextPersonId, kv.first + 1);
 
-        nextAppointmentId = 1;
-        for (auto &kv : appointments) nextAppointmentId = max(nextAppointmentId, kv.first + 1);
+        recountAppointmentIds();
+        recountBillIds();
 
-        nextBillId = 1;
-        for (auto &kv : bills) nextBillId = max(nextBillId, kv.first + 1);
+        loadTimings.push_back({"total", chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count()});
     }
 
+    void printLoadTimings() const {
+        cout << "--- Load times (ms) ---\n";
+        for (auto &t : loadTimings) cout << setw(16) << left << t.first << fixed << setprecision(2) << t.second << "\n";
+    }
+
+    // Mutations are already in the journal; only fold it into the base
+    // files once it has grown past the threshold.
     void saveAll() {
-        saveUsers();
-        savePatients();
-        saveDoctors();
-        saveStaff();
-        saveAppointments();
-        saveBills();
-        pharmacy.saveToFile(MEDICINES_FILE);
+        flushRawEdits();
+        if (journal.size() >= JOURNAL_COMPACT_THRESHOLD) compact();
+    }
+
+    // rewrite the base files of changed tables and start an empty journal
+    void compact() {
+        rawEdits.clear(); // their rows go out with the table rewrite
+        if (isDirty(TBL_USERS)) saveUsers();
+        if (isDirty(TBL_PATIENTS)) savePatients();
+        if (isDirty(TBL_DOCTORS)) saveDoctors();
+        if (isDirty(TBL_STAFF)) saveStaff();
+        if (isDirty(TBL_APPOINTMENTS)) saveAppointments();
+        if (isDirty(TBL_BILLS)) saveBills();
+        if (isDirty(TBL_MEDICINES)) {
+            auto stock = make_shared<PharmacyService>(pharmacy);
+            writer.writeFile(MEDICINES_FILE, [stock](ostream &out) { stock->writeTo(out); });
+        }
+        for (int t = 0; t < TBL_COUNT; ++t) savedGen[t] = changeGen[t];
+        journal.truncate();
+        compacted = true;
+    }
+
+    bool isDirty(Table t) const { return changeGen[t] != savedGen[t]; }
+    bool anyDirty() const {
+        for (int t = 0; t < TBL_COUNT; ++t) if (isDirty((Table)t)) return true;
+        return false;
+    }
+
+    // Exit path: fold the journal into the base files so the snapshot can
+    // describe them exactly, write the snapshot and wait for the writer.
+    // Safe to call twice.
+    void shutdown() {
+        if (closed) return;
+        closed = true;
+        flushRawEdits();
+        if (journal.size() > 0) compact();
+        // a session that only read leaves every file, the snapshot included, untouched
+        if (SNAPSHOT_ENABLED && (!snapshotCurrent || compacted || anyDirty())) writeSnapshot();
+        if (!flush()) { setColor(12); cout << "Warning: not all data could be saved (" << writer.lastError() << ").\n"; setColor(7); }
+    }
+
+    // barrier: returns once every queued write has reached the files;
+    // false if one of them failed (persistenceError() says which)
+    bool flush() { return writer.flush(); }
+    string persistenceError() { return writer.lastError(); }
+    void writeSnapshot() {
+        SnapshotWriter w;
+        string sections;
+        uint32_t count = 0;
+
+        w.u32((uint32_t)users.size());
+        for (auto &u : users) { w.str(u.username); w.str(u.role); w.str(u.password); w.i32(u.linkedId); }
+        w.endSection(SNAP_USERS, sections); ++count;
+
+        w.u32((uint32_t)patients.size());
+        for (auto &kv : patients) {
+            auto &p = kv.second;
+            w.i32(p.getId()); w.str(p.getName()); w.i32(p.getAge()); w.str(p.getGender()); w.str(p.getContact());
+            w.u8(p.isInsured()); w.str(p.getInsuranceProvider()); w.str(p.getNationalId());
+        }
+        w.endSection(SNAP_PATIENTS, sections); ++count;
+
+        w.u32((uint32_t)doctors.size());
+        for (auto &kv : doctors) {
+            auto &d = kv.second;
+            w.i32(d.getId()); w.str(d.getName()); w.i32(d.getAge()); w.str(d.getGender()); w.str(d.getContact());
+            w.str(d.getSpecialization()); w.f64(d.getFee());
+        }
+        w.endSection(SNAP_DOCTORS, sections); ++count;
+
+        w.u32((uint32_t)staffs.size());
+        for (auto &kv : staffs) {
+            auto &st = kv.second;
+            w.i32(st.getId()); w.str(st.getName()); w.i32(st.getAge()); w.str(st.getGender()); w.str(st.getContact());
+            w.str(st.getRole()); w.str(st.getUsername());
+        }
+        w.endSection(SNAP_STAFF, sections); ++count;
+
+        // a table still in lazy mode is left out; readers take it from the CSV file
+        if (!lazyAppointments.enabled) {
+            w.u32((uint32_t)appointments.size());
+            for (auto &kv : appointments) {
+                auto &a = kv.second;
+                w.i32(a.id); w.i32(a.patientId); w.i32(a.doctorId); w.i64(a.datetime.seconds()); w.str(a.datetimeText); w.str(a.type); w.str(a.reason);
+            }
+            w.endSection(SNAP_APPOINTMENTS, sections); ++count;
+        }
+
+        if (!lazyBills.enabled) {
+            w.u32((uint32_t)bills.size());
+            for (auto &kv : bills) {
+                auto &b = kv.second;
+                w.i32(b.billId); w.i32(b.patientId); w.u8(b.insured); w.f64(b.coveragePercent); w.i64(b.createdAt.seconds()); w.str(b.createdAtText);
+                w.u32((uint32_t)b.lineItems().size());
+                for (auto &it : b.lineItems()) { w.str(it.desc()); w.i64(it.amount.minor()); }
+            }
+            w.endSection(SNAP_BILLS, sections); ++count;
+        }
+
+        w.u32((uint32_t)pharmacy.getStock().size());
+        for (auto &kv : pharmacy.getStock()) { w.str(kv.first); w.i32(kv.second); w.str(pharmacy.expiryOf(kv.first)); }
+        w.endSection(SNAP_MEDICINES, sections); ++count;
+
+        // the pool goes first so the reader has it before any record
+        auto body = make_shared<string>();
+        w.endPool(*body); ++count;
+        *body += sections;
+
+        uint32_t meta[2] = {SNAPSHOT_VERSION, count};
+        int32_t ids[4] = {nextPersonId, nextAppointmentId, nextBillId, 0};
+        // the header is built on the writer thread, after the CSV writes
+        // queued before it, so the fingerprint describes the final files
+        writer.writeFile(SNAPSHOT_FILE, [body, meta, ids](ostream &out) {
+            string header(SNAPSHOT_MAGIC, 8);
+            uint64_t fingerprint = dataFilesFingerprint();
+            header.append((const char*)meta, sizeof(meta));
+            header.append((const char*)ids, sizeof(ids));
+            header.append((const char*)&fingerprint, 8);
+            uint64_t sum = checksum64(header.data(), header.size());
+            header.append((const char*)&sum, 8);
+            out << header << *body;
+        }, true);
+    }
+
+    // Loads every table from shms.snap. Returns false, with the tables left
+    // empty, if the file is missing, stale, corrupt or from another version.
+    bool loadSnapshot() {
+        MappedFile mf(SNAPSHOT_FILE);
+        string_view data = mf.view();
+        const size_t headerSize = 8 + 8 + 16 + 8;
+        if (data.size() < headerSize + 8 || memcmp(data.data(), SNAPSHOT_MAGIC, 8) != 0) return false;
+        uint32_t meta[2]; int32_t ids[4]; uint64_t fingerprint, sum;
+        memcpy(meta, data.data() + 8, 8);
+        memcpy(ids, data.data() + 16, 16);
+        memcpy(&fingerprint, data.data() + 32, 8);
+        memcpy(&sum, data.data() + headerSize, 8);
+        if (meta[0] != SNAPSHOT_VERSION || sum != checksum64(data.data(), headerSize)) return false;
+        if (fingerprint != dataFilesFingerprint()) return false;
+
+        // split into sections and verify every checksum before touching the tables
+        map<uint32_t, string_view> sections;
+        size_t pos = headerSize + 8;
+        for (uint32_t i = 0; i < meta[1]; ++i) {
+            if (data.size() - pos < 16) return false;
+            uint32_t hdr[2]; uint64_t s;
+            memcpy(hdr, data.data() + pos, 8);
+            memcpy(&s, data.data() + pos + 8, 8);
+            pos += 16;
+            if (data.size() - pos < hdr[1]) return false;
+            string_view payload = data.substr(pos, hdr[1]);
+            if (checksum64(payload.data(), payload.size()) != s) return false;
+            sections[hdr[0]] = payload;
+            pos += hdr[1];
+        }
+        if (!sections.count(SNAP_POOL)) return false;
+        string_view pool = sections[SNAP_POOL];
+
+        users.clear(); patients.clear(); doctors.clear(); staffs.clear();
+        clearAppointments(); clearBills();
+        pharmacy.clear();
+        bool ok = true;
+
+        { SnapshotReader r(sections[SNAP_USERS], pool);
+          for (uint32_t n = r.u32(); n > 0 && r.ok; --n) {
+              User u; u.username = r.str(); u.role = r.str(); u.password = r.str(); u.linkedId = r.i32();
+              users[u.username] = u;
+          }
+          ok = ok && r.ok; }
+        { SnapshotReader r(sections[SNAP_PATIENTS], pool);
+          for (uint32_t n = r.u32(); n > 0 && r.ok; --n) {
+              int id = r.i32(); string name = r.str(); int age = r.i32(); string gender = r.str(); string contact = r.str();
+              bool insured = r.u8() != 0; string prov = r.str(); string nid = r.str();
+              patients[id] = Patient(id, name, age, gender, contact, insured, prov, nid);
+          }
+          ok = ok && r.ok; }
+        { SnapshotReader r(sections[SNAP_DOCTORS], pool);
+          for (uint32_t n = r.u32(); n > 0 && r.ok; --n) {
+              int id = r.i32(); string name = r.str(); int age = r.i32(); string gender = r.str(); string contact = r.str();
+              string spec = r.str(); double fee = r.f64();
+              doctors[id] = Doctor(id, name, age, gender, contact, spec, fee);
+          }
+          ok = ok && r.ok; }
+        { SnapshotReader r(sections[SNAP_STAFF], pool);
+          for (uint32_t n = r.u32(); n > 0 && r.ok; --n) {
+              int id = r.i32(); string name = r.str(); int age = r.i32(); string gender = r.str(); string contact = r.str();
+              string role = r.str(); string uname = r.str();
+              staffs[id] = Staff(id, name, age, gender, contact, role, uname);
+          }
+          ok = ok && r.ok; }
+        // lazy mode indexes these from the CSV files instead (they match the snapshot)
+        bool appointmentsFromCSV = lazyHistory || !sections.count(SNAP_APPOINTMENTS);
+        bool billsFromCSV = lazyHistory || !sections.count(SNAP_BILLS);
+        if (!appointmentsFromCSV) { SnapshotReader r(sections[SNAP_APPOINTMENTS], pool);
+          for (uint32_t n = r.u32(); n > 0 && r.ok; --n) {
+              Appointment a;
+              a.id = r.i32(); a.patientId = r.i32(); a.doctorId = r.i32();
+              a.datetime = Timestamp(r.i64()); a.datetimeText = r.str(); a.type = r.str(); a.reason = r.str();
+              putAppointment(std::move(a));
+          }
+          ok = ok && r.ok; }
+        if (!billsFromCSV) { SnapshotReader r(sections[SNAP_BILLS], pool);
+          for (uint32_t n = r.u32(); n > 0 && r.ok; --n) {
+              Bill b;
+              b.billId = r.i32(); b.patientId = r.i32(); b.insured = r.u8() != 0; b.coveragePercent = r.f64();
+              b.createdAt = Timestamp(r.i64()); b.createdAtText = r.str();
+              for (uint32_t k = r.u32(); k > 0 && r.ok; --k) { string desc = r.str(); b.addItem(desc, Money::fromMinor(r.i64())); }
+              putBill(std::move(b));
+          }
+          ok = ok && r.ok; }
+        { SnapshotReader r(sections[SNAP_MEDICINES], pool);
+          for (uint32_t n = r.u32(); n > 0 && r.ok; --n) {
+              string name = r.str(); int qty = r.i32(); string exp = r.str();
+              pharmacy.setMedicine(name, qty, exp);
+          }
+          ok = ok && r.ok; }
+
+        if (!ok) {
+            users.clear(); patients.clear(); doctors.clear(); staffs.clear();
+            clearAppointments(); clearBills(); pharmacy.clear();
+            return false;
+        }
+        if (!lazyHistory) {
+            // the snapshot was written while these were still lazy
+            if (appointmentsFromCSV) loadAppointments();
+            if (billsFromCSV) loadBills();
+            linkDoctorSlots();
+        }
+        indexPatients();
+        indexSpecializations();
+        nextPersonId = ids[0];
+        // the header counters only describe tables that are in the snapshot;
+        // one written while a table was lazy says nothing about its ids
+        if (appointmentsFromCSV) recountAppointmentIds(); else nextAppointmentId = ids[1];
+        if (billsFromCSV) recountBillIds(); else nextBillId = ids[2];
+        return true;
     }
 
+
     void loadUsers() {
         users.clear();
-        ifstream in(USERS_FILE);
-        if (!in.is_open()) {
+        bool found = forEachCSVRow(USERS_FILE, [&](const string_view *r, size_t n) {
+            User u = User::fromFields(r, n);
+            users[u.username] = u;
+        });
+        if (!found) {
             // create default admin and receptionist
             User admin{"admin","Admin","admin",0};
             User recept{"recept","Receptionist","recept",0};
             users[admin.username] = admin;
             users[recept.username] = recept;
-            return;
-        }
-        string line;
-        while (getline(in, line)) {
-            if (trim(line).empty()) continue;
-            auto r = splitCSV(line);
-            User u = User::fromCSV(r);
-            users[u.username] = u;
+            touch(TBL_USERS); // defaults only exist in memory so far
         }
     }
+    // the writer thread serializes a copy, so later edits cannot race it
     void saveUsers() {
-        ofstream out(USERS_FILE);
-        for (auto &kv : users) out << joinCSV(kv.second.toCSV()) << "\n";
+        auto rows = make_shared<UserTable>(users);
+        writer.writeFile(USERS_FILE, [rows](ostream &out) {
+            CsvWriter w(&out);
+            for (auto &u : *rows) u.writeCSV(w);
+        });
     }
 
     void loadPatients() {
         patients.clear();
-        ifstream in(PATIENTS_FILE);
-        if (!in.is_open()) return;
-        string line;
-        while (getline(in, line)) {
-            if (trim(line).empty()) continue;
-            auto r = splitCSV(line);
-            Patient p = Patient::fromCSV(r);
-            patients[p.getId()] = p;
-        }
+        legacyHistory.clear();
+        forEachCSVRow(PATIENTS_FILE, [&](const string_view *r, size_t n) {
+            Patient p = Patient::fromFields(r, n);
+            if (n >= 9 && !r[8].empty()) legacyHistory[p.getId()] = string(r[8]);
+            patients[p.getId()] = std::move(p);
+        });
+        indexPatients();
     }
+    // the writer thread serializes a copy, so later edits cannot race it
     void savePatients() {
-        ofstream out(PATIENTS_FILE);
-        for (auto &kv : patients) out << joinCSV(kv.second.toCSVRow()) << "\n";
+        auto rows = make_shared<SlotMap<Patient>>(patients);
+        writer.writeFile(PATIENTS_FILE, [rows](ostream &out) {
+            CsvWriter w(&out);
+            for (auto &kv : *rows) kv.second.writeCSV(w);
+        });
+    }
+
+    // history.txt is only ever appended to, never rewritten
+    void loadHistory() {
+        history.clear();
+        forEachCSVRow(HISTORY_FILE, [&](const string_view *r, size_t n) {
+            if (n >= 3) history.append(parseIntView(r[0], 0), {Timestamp::parse(r[1]), string(r[2])});
+        });
+    }
+    void appendHistory(int pid, HistoryEntry e) {
+        historyLine.clear();
+        e.writeCSV(historyLine, pid);
+        writer.append(HISTORY_FILE, historyLine.str());
+        history.append(pid, std::move(e));
+    }
+    // Moves the free-text column of older patient rows into history.txt, one
+    // undated entry per line, then rewrites patients.txt without it. A
+    // patient who already has entries was migrated by an earlier run.
+    void adoptLegacyHistory() {
+        if (legacyHistory.empty()) return;
+        for (auto &kv : legacyHistory) {
+            if (history.count(kv.first) > 0) continue;
+            istringstream lines(kv.second);
+            string line;
+            while (getline(lines, line)) {
+                if (!trimView(line).empty()) appendHistory(kv.first, {Timestamp(), string(trimView(line))});
+            }
+        }
+        legacyHistory.clear();
+        savePatients();
     }
 
     void loadDoctors() {
         doctors.clear();
-        ifstream in(DOCTORS_FILE);
-        if (!in.is_open()) return;
-        string line;
-        while (getline(in, line)) {
-            if (trim(line).empty()) continue;
-            auto r = splitCSV(line);
-            Doctor d = Doctor::fromCSV(r);
-            doctors[d.getId()] = d;
-        }
+        forEachCSVRow(DOCTORS_FILE, [&](const string_view *r, size_t n) {
+            Doctor d = Doctor::fromFields(r, n);
+            doctors[d.getId()] = std::move(d);
+        });
+        indexSpecializations();
     }
+    // the writer thread serializes a copy, so later edits cannot race it
     void saveDoctors() {
-        ofstream out(DOCTORS_FILE);
-        for (auto &kv : doctors) out << joinCSV(kv.second.toCSVRow()) << "\n";
+        auto rows = make_shared<SlotMap<Doctor>>(doctors);
+        writer.writeFile(DOCTORS_FILE, [rows](ostream &out) {
+            CsvWriter w(&out);
+            for (auto &kv : *rows) kv.second.writeCSV(w);
+        });
     }
 
     void loadStaff() {
         staffs.clear();
-        ifstream in(STAFF_FILE);
-        if (!in.is_open()) return;
-        string line;
-        while (getline(in, line)) {
-            if (trim(line).empty()) continue;
-            auto r = splitCSV(line);
-            Staff s = Staff::fromCSV(r);
-            staffs[s.getId()] = s;
-        }
+        forEachCSVRow(STAFF_FILE, [&](const string_view *r, size_t n) {
+            Staff s = Staff::fromFields(r, n);
+            staffs[s.getId()] = std::move(s);
+        });
     }
+    // the writer thread serializes a copy, so later edits cannot race it
     void saveStaff() {
-        ofstream out(STAFF_FILE);
-        for (auto &kv : staffs) out << joinCSV(kv.second.toCSVRow()) << "\n";
+        auto rows = make_shared<SlotMap<Staff>>(staffs);
+        writer.writeFile(STAFF_FILE, [rows](ostream &out) {
+            CsvWriter w(&out);
+            for (auto &kv : *rows) kv.second.writeCSV(w);
+        });
     }
 
     void loadAppointments() {
-        appointments.clear();
-        ifstream in(APPOINTMENTS_FILE);
-        if (!in.is_open()) return;
-        string line;
-        while (getline(in, line)) {
-            if (trim(line).empty()) continue;
-            auto r = splitCSV(line);
-            Appointment a = Appointment::fromCSV(r);
-            appointments[a.id] = a;
-            // add booked slot to doctor if exists
-            if (doctors.count(a.doctorId)) doctors[a.doctorId].addBookedSlot(a.datetime);
-        }
+        clearAppointments();
+        forEachCSVRow(APPOINTMENTS_FILE, [&](const string_view *r, size_t n) {
+            putAppointment(Appointment::fromFields(r, n));
+        });
+    }
+    // build the doctor calendars; runs after doctors and appointments are both loaded
+    void linkDoctorSlots() {
+        for (auto &kv : appointments) bookDoctorSlot(kv.second);
     }
     void saveAppointments() {
-        ofstream out(APPOINTMENTS_FILE);
-        for (auto &kv : appointments) out << joinCSV(kv.second.toCSV()) << "\n";
+        ensureAllAppointments(); // also unmaps the file before it is rewritten
+        auto rows = make_shared<SlotMap<Appointment>>(appointments);
+        writer.writeFile(APPOINTMENTS_FILE, [rows](ostream &out) {
+            CsvWriter w(&out);
+            for (auto &kv : *rows) kv.second.writeCSV(w);
+        });
     }
 
     void loadBills() {
-        bills.clear();
-        ifstream in(BILLS_FILE);
-        if (!in.is_open()) return;
-        string line;
-        while (getline(in, line)) {
-            if (trim(line).empty()) continue;
-            auto r = splitCSV(line);
-            Bill b = Bill::fromCSV(r);
-            bills[b.billId] = b;
-        }
+        clearBills();
+        forEachCSVRow(BILLS_FILE, [&](const string_view *r, size_t n) {
+            putBill(Bill::fromFields(r, n));
+        });
     }
     void saveBills() {
-        ofstream out(BILLS_FILE);
-        for (auto &kv : bills) out << joinCSV(kv.second.toCSV()) << "\n";
+        ensureAllBills();
+        auto rows = make_shared<SlotMap<Bill>>(bills);
+        writer.writeFile(BILLS_FILE, [rows](ostream &out) {
+            CsvWriter w(&out);
+            for (auto &kv : *rows) kv.second.writeCSV(w);
+        });
     }
 
     // seed demo data if empty
@@ -881,12 +3980,14 @@ public:
 		
             pharmacy.addMedicine("Paracetamol", 100, "2026-12-31");
             pharmacy.addMedicine("Amoxicillin", 50, "2025-05-30");
+            touch(TBL_MEDICINES);
             
             // ensure default users exist
             if (!users.count("admin")) users["admin"] = User{"admin","Admin","admin",0};
             if (!users.count("recept")) users["recept"] = User{"recept","Receptionist","recept",0};
             if (!users.count("muneeba")) users["muneeba"] = User{"muneeba","Patient","password", 1}; // link to pid 1
-            saveAll();
+            touch(TBL_USERS);
+            compact();
         }
     }
 
@@ -895,112 +3996,304 @@ public:
         int id = nextPersonId++;
         Patient cp = p; cp.setId(id);
         patients[id] = cp;
+        indexPatient(cp);
+        record(TBL_PATIENTS, 'P', cp);
         return id;
     }
     int addDoctor(const Doctor &d) {
         int id = nextPersonId++;
         Doctor cp = d; cp.setId(id);
         doctors[id] = cp;
+        specialties.set(id, cp.getSpecialization().str());
+        record(TBL_DOCTORS, 'D', cp);
         return id;
     }
     int addStaff(const Staff &s) {
         int id = nextPersonId++;
         Staff cp = s; cp.setId(id);
         staffs[id] = cp;
+        record(TBL_STAFF, 'S', cp);
         return id;
     }
 
-    Patient* findPatient(int id) { if (patients.count(id)) return &patients[id]; return nullptr; }
-    Doctor* findDoctor(int id) { if (doctors.count(id)) return &doctors[id]; return nullptr; }
-    Staff* findStaff(int id) { if (staffs.count(id)) return &staffs[id]; return nullptr; }
+    const Patient* findPatient(int id) const { auto it = patients.find(id); return it == patients.end() ? nullptr : &it->second; }
+    const Doctor* findDoctor(int id) const { auto it = doctors.find(id); return it == doctors.end() ? nullptr : &it->second; }
+    const Staff* findStaff(int id) const { auto it = staffs.find(id); return it == staffs.end() ? nullptr : &it->second; }
 
-    vector<Patient> searchPatientsByName(const string &name) {
-        vector<Patient> out;
-        for (auto &kv : patients) if (kv.second.getName().find(name) != string::npos) out.push_back(kv.second);
-        return out;
+    // mutable access: the row is marked dirty and journaled on the next saveAll()
+    Patient* editPatient(int id) {
+        auto it = patients.find(id); if (it == patients.end()) return nullptr;
+        touch(TBL_PATIENTS); rawEdits.push_back({TBL_PATIENTS, id});
+        pendingPatientChecks.push_back(id);
+        return &it->second;
     }
-    vector<Doctor> searchDoctorsBySpec(const string &spec) {
-        vector<Doctor> out;
-        for (auto &kv : doctors) if (kv.second.getSpecialization().find(spec) != string::npos) out.push_back(kv.second);
-        return out;
+    Doctor* editDoctor(int id) {
+        auto it = doctors.find(id); if (it == doctors.end()) return nullptr;
+        touch(TBL_DOCTORS); rawEdits.push_back({TBL_DOCTORS, id});
+        pendingSpecChecks.push_back(id);
+        return &it->second;
+    }
+    Staff* editStaff(int id) {
+        auto it = staffs.find(id); if (it == staffs.end()) return nullptr;
+        touch(TBL_STAFF); rawEdits.push_back({TBL_STAFF, id});
+        return &it->second;
     }
 
-    bool isDoctorAvailable(int doctorId, const string &datetime) {
-        Doctor* d = findDoctor(doctorId);
-        if (!d) return false;
-        for (auto &slot : d->getBookedSlots()) if (datetimeConflict(slot, datetime)) return false;
+    // Medical history: one line per entry, stamped with the current time and
+    // appended to history.txt straight away
+    bool addHistory(int patientId, const string &text) {
+        string line = text;
+        replace(line.begin(), line.end(), '\n', ' ');
+        replace(line.begin(), line.end(), '\r', ' ');
+        string_view t = trimView(line);
+        if (!patients.count(patientId) || t.empty()) return false;
+        appendHistory(patientId, {Timestamp::now(), string(t)});
         return true;
     }
+    size_t historyCount(int patientId) const { return history.count(patientId); }
+    // page 0 is the newest pageSize entries, page 1 the ones before them, ...
+    vector<const HistoryEntry*> recentHistory(int patientId, size_t page = 0, size_t pageSize = 10) const {
+        return history.recent(patientId, page * pageSize, pageSize);
+    }
+    void printHistory(int patientId, size_t page = 0, size_t pageSize = 10) const {
+        auto entries = recentHistory(patientId, page, pageSize);
+        if (entries.empty()) return;
+        cout << "  Medical History (newest first):\n";
+        for (auto *e : entries) {
+            cout << "   - ";
+            if (e->at.valid()) cout << e->at.str() << " | ";
+            cout << e->text << "\n";
+        }
+        size_t shown = page * pageSize + entries.size(), total = historyCount(patientId);
+        if (shown < total) cout << "   (" << total - shown << " older)\n";
+    }
+
+    // patient ids whose name contains (SUBSTRING) or has a word starting
+    // with (PREFIX) the query, ignoring case; best matches first
+    vector<int> findPatientsByName(const string &query, TrigramIndex::Mode mode = TrigramIndex::SUBSTRING, size_t limit = 0) {
+        syncPatientEdits();
+        return patientNames.search(query, mode, limit);
+    }
+    // exact matches after normalization (see normalizeNationalId / normalizePhone)
+    vector<int> findPatientsByNationalId(const string &nid) { syncPatientEdits(); return nationalIds.find(nid); }
+    vector<int> findPatientsByPhone(const string &contact) { syncPatientEdits(); return phones.find(contact); }
+    // registered patients sharing p's national ID or phone, ascending
+    vector<int> possibleDuplicates(const Patient &p) {
+        vector<int> ids = findPatientsByNationalId(p.getNationalId());
+        for (int id : findPatientsByPhone(p.getContact())) ids.push_back(id);
+        sort(ids.begin(), ids.end());
+        ids.erase(unique(ids.begin(), ids.end()), ids.end());
+        return ids;
+    }
+    QueryView<Patient> patientView(const vector<int> &ids) {
+        vector<const Patient*> rows;
+        for (int id : ids) rows.push_back(&patients.at(id));
+        return QueryView<Patient>(std::move(rows), &changeGen[TBL_PATIENTS]);
+    }
+    QueryView<Patient> patientsByName(const string &query, TrigramIndex::Mode mode = TrigramIndex::SUBSTRING, size_t limit = 0) {
+        return patientView(findPatientsByName(query, mode, limit));
+    }
+    vector<Patient> searchPatientsByName(const string &name) { return patientsByName(name).toVector(); }
+    QueryView<Patient> patientsByNationalId(const string &nid) { return patientView(findPatientsByNationalId(nid)); }
+    QueryView<Patient> patientsByPhone(const string &contact) { return patientView(findPatientsByPhone(contact)); }
+    // doctors whose specialization matches spec after stemming ("psychologist" finds "psychology")
+    vector<int> findDoctorsBySpec(const string &spec) {
+        syncSpecializationEdits();
+        return specialties.match(spec);
+    }
+    QueryView<Doctor> doctorsBySpec(const string &spec) {
+        vector<const Doctor*> rows;
+        for (int id : findDoctorsBySpec(spec)) rows.push_back(&doctors.at(id));
+        return QueryView<Doctor>(std::move(rows), &changeGen[TBL_DOCTORS]);
+    }
+    vector<Doctor> searchDoctorsBySpec(const string &spec) { return doctorsBySpec(spec).toVector(); }
+
+    struct DoctorOffer { int doctorId; double fee; Timestamp firstFree; };
+    enum DoctorOrder { CHEAPEST, EARLIEST }; // ties go to the other key, then the id
+
+    // The k best doctors for spec that have a free slot in [from, until).
+    // Only doctors in the specialization index entry are looked at, and a
+    // heap of size k keeps the best so far.
+    vector<DoctorOffer> topDoctorsForSpec(const string &spec, size_t k, Timestamp from, Timestamp until, DoctorOrder order = CHEAPEST) {
+        auto better = [order](const DoctorOffer &a, const DoctorOffer &b) {
+            if (order == CHEAPEST && a.fee != b.fee) return a.fee < b.fee;
+            if (a.firstFree != b.firstFree) return a.firstFree < b.firstFree;
+            if (a.fee != b.fee) return a.fee < b.fee;
+            return a.doctorId < b.doctorId;
+        };
+        priority_queue<DoctorOffer, vector<DoctorOffer>, decltype(better)> heap(better); // worst kept on top
+        if (k == 0 || !from.valid()) return {};
+        for (int id : findDoctorsBySpec(spec)) {
+            loadAppointmentsOfDoctor(id); // books the calendar
+            const Doctor &d = doctors.at(id);
+            Timestamp slot = Timestamp::fromMinutes(d.firstFreeFrom(from.minutes()));
+            if (until.valid() && slot >= until) continue;
+            DoctorOffer offer{id, d.getFee(), slot};
+            if (heap.size() < k) heap.push(offer);
+            else if (better(offer, heap.top())) { heap.pop(); heap.push(offer); }
+        }
+        vector<DoctorOffer> out;
+        for (; !heap.empty(); heap.pop()) out.push_back(heap.top());
+        reverse(out.begin(), out.end());
+        return out;
+    }
+    // "cheapest available cardiologist today"
+    vector<DoctorOffer> cheapestAvailableToday(const string &spec, size_t k = 1) {
+        Timestamp now = Timestamp::now();
+        return topDoctorsForSpec(spec, k, now, now.startOfDay().plusDays(1), CHEAPEST);
+    }
+
+    // -------- duplicate detection (offline, see findMergeCandidates) --------
+    vector<MergeCandidate> duplicatePatients(size_t threads = 0) const { return findMergeCandidates(dedupRecords(patients), threads); }
+    vector<MergeCandidate> duplicateDoctors(size_t threads = 0) const { return findMergeCandidates(dedupRecords(doctors), threads); }
+
+    // writes the pairs from the two scans to MERGE_CANDIDATES_FILE for
+    // review; nothing is merged
+    void writeMergeCandidates(const vector<MergeCandidate> &patientPairs, const vector<MergeCandidate> &doctorPairs) {
+        struct Row { const char *table; MergeCandidate c; string keepName, duplicateName; };
+        auto rows = make_shared<vector<Row>>();
+        for (auto &c : patientPairs)
+            rows->push_back({"patients", c, patients.at(c.keepId).getName(), patients.at(c.duplicateId).getName()});
+        for (auto &c : doctorPairs)
+            rows->push_back({"doctors", c, doctors.at(c.keepId).getName(), doctors.at(c.duplicateId).getName()});
+        writer.writeFile(MERGE_CANDIDATES_FILE, [rows](ostream &out) {
+            CsvWriter w(&out);
+            for (auto &r : *rows) {
+                w.field(r.table).field(r.c.keepId).field(r.c.duplicateId).field(r.c.distance).field(r.keepName).field(r.duplicateName);
+                w.endRow();
+            }
+        });
+    }
+
+    bool isDoctorAvailable(int doctorId, Timestamp when) {
+        if (!when.valid()) return false;
+        loadAppointmentsOfDoctor(doctorId); // books the doctor's calendar
+        const Doctor* d = findDoctor(doctorId);
+        return d && d->isFreeAt(when.minutes());
+    }
 
     int scheduleAppointment(const Appointment &a) {
         if (!patients.count(a.patientId)) throw runtime_error("Patient not found");
         if (!doctors.count(a.doctorId)) throw runtime_error("Doctor not found");
+        if (!a.datetime.valid()) throw runtime_error("Invalid date/time (expected YYYY-MM-DD HH:MM)");
         if (!isDoctorAvailable(a.doctorId, a.datetime)) throw runtime_error("Doctor not available at requested datetime (conflict)");
+        ensureAppointmentIndex(); // file ids must be known before a new one is handed out
         int id = nextAppointmentId++;
         Appointment cp = a; cp.id = id;
-        appointments[id] = cp;
-        doctors[a.doctorId].addBookedSlot(a.datetime);
+        putAppointment(cp);
+        bookDoctorSlot(cp);
+        record(TBL_APPOINTMENTS, 'A', cp);
         return id;
     }
 
-    vector<Appointment> getAppointmentsForPatient(int pid) {
-        vector<Appointment> out;
-        for (auto &kv : appointments) if (kv.second.patientId == pid) out.push_back(kv.second);
-        return out;
+    // all of these are ordered by time
+    QueryView<Appointment> appointmentsForPatient(int pid) {
+        loadAppointmentsOfPatient(pid);
+        vector<const Appointment*> rows;
+        apptsByPatient.forEach(pid, [&](int id) { rows.push_back(&appointments.at(id)); });
+        return QueryView<Appointment>(std::move(rows), &changeGen[TBL_APPOINTMENTS]);
     }
-    vector<Appointment> getAppointmentsForDoctor(int did) {
-        vector<Appointment> out;
-        for (auto &kv : appointments) if (kv.second.doctorId == did) out.push_back(kv.second);
-        return out;
+    QueryView<Appointment> appointmentsForDoctor(int did) {
+        loadAppointmentsOfDoctor(did);
+        vector<const Appointment*> rows;
+        apptsByDoctor.forEach(did, [&](int id) { rows.push_back(&appointments.at(id)); });
+        return QueryView<Appointment>(std::move(rows), &changeGen[TBL_APPOINTMENTS]);
+    }
+    // from <= datetime < to, e.g. this week: (now.startOfWeek(), now.startOfWeek().plusDays(7))
+    QueryView<Appointment> appointmentsForPatientBetween(int pid, Timestamp from, Timestamp to) {
+        loadAppointmentsOfPatient(pid);
+        vector<const Appointment*> rows;
+        apptsByPatient.forEachBetween(pid, from, to, [&](int id) { rows.push_back(&appointments.at(id)); });
+        return QueryView<Appointment>(std::move(rows), &changeGen[TBL_APPOINTMENTS]);
     }
+    QueryView<Appointment> appointmentsForDoctorBetween(int did, Timestamp from, Timestamp to) {
+        loadAppointmentsOfDoctor(did);
+        vector<const Appointment*> rows;
+        apptsByDoctor.forEachBetween(did, from, to, [&](int id) { rows.push_back(&appointments.at(id)); });
+        return QueryView<Appointment>(std::move(rows), &changeGen[TBL_APPOINTMENTS]);
+    }
+    vector<Appointment> getAppointmentsForPatient(int pid) { return appointmentsForPatient(pid).toVector(); }
+    vector<Appointment> getAppointmentsForDoctor(int did) { return appointmentsForDoctor(did).toVector(); }
+    vector<Appointment> getAppointmentsForPatientBetween(int pid, Timestamp from, Timestamp to) { return appointmentsForPatientBetween(pid, from, to).toVector(); }
+    vector<Appointment> getAppointmentsForDoctorBetween(int did, Timestamp from, Timestamp to) { return appointmentsForDoctorBetween(did, from, to).toVector(); }
 
-    bool cancelAppointment(int aid) {
+    bool cancelAppointment(int aid, bool record = true) {
+        loadAppointmentId(aid);
         if (!appointments.count(aid)) return false;
-        Appointment a = appointments[aid];
-        if (doctors.count(a.doctorId)) {
-            auto &slots = const_cast<vector<string>&>(doctors[a.doctorId].getBookedSlots());
-            slots.erase(remove_if(slots.begin(), slots.end(), [&](const string &s){ return datetimeConflict(s, a.datetime); }), slots.end());
-        }
-        appointments.erase(aid);
+        releaseDoctorSlot(appointments[aid]);
+        eraseAppointment(aid);
+        touch(TBL_APPOINTMENTS);
+        if (record) journal.append('X', {to_string(aid)});
         return true;
     }
 
     int createBill(int pid, bool insured, double coverage) {
         if (!patients.count(pid)) throw runtime_error("Patient not found");
+        ensureBillIndex();
         int id = nextBillId++;
-        bills[id] = Bill(id, pid, insured, coverage);
+        putBill(Bill(id, pid, insured, coverage));
+        record(TBL_BILLS, 'B', bills[id]);
         return id;
     }
-    void addBillItem(int billId, const string &desc, double amt) {
+    void addBillItem(int billId, const string &item, Money amount) {
+        loadBillId(billId);
         if (!bills.count(billId)) throw runtime_error("Bill not found");
-        bills[billId].addItem(desc, amt);
+        bills[billId].addItem(item, amount);
+        billColumns.set(bills[billId]);
+        record(TBL_BILLS, 'B', bills[billId]);
+    }
+    const Bill* getBill(int id) { loadBillId(id); auto it = bills.find(id); return it == bills.end() ? nullptr : &it->second; }
+    Bill* editBill(int id) {
+        loadBillId(id);
+        auto it = bills.find(id); if (it == bills.end()) return nullptr;
+        touch(TBL_BILLS); rawEdits.push_back({TBL_BILLS, id});
+        pendingBillChecks.push_back(id);
+        return &it->second;
     }
-    Bill* getBill(int id) { if (bills.count(id)) return &bills[id]; return nullptr; }
 
     // new: get bills for a patient (safe, efficient)
-    vector<Bill> getBillsForPatient(int pid) const {
-        vector<Bill> out;
-        for (auto &kv : bills) if (kv.second.patientId == pid) out.push_back(kv.second);
-        return out;
+    QueryView<Bill> billsForPatient(int pid) {
+        loadBillsOfPatient(pid);
+        syncBillEdits(); // an edited bill may have changed patient
+        vector<const Bill*> rows;
+        billColumns.forEachBillOf(pid, [&](int id) { rows.push_back(&bills.at(id)); });
+        return QueryView<Bill>(std::move(rows), &changeGen[TBL_BILLS]);
     }
+    vector<Bill> getBillsForPatient(int pid) { return billsForPatient(pid).toVector(); }
 
     // pharmacy, diagnostics wrappers
-    PharmacyService& getPharmacy() { return pharmacy; }
+    const PharmacyService& getPharmacy() const { return pharmacy; }
+    void addMedicine(const string &name, int qty, const string &exp) {
+        pharmacy.addMedicine(name, qty, exp);
+        journalMedicine(name);
+    }
+    bool issueMedicine(const string &name, int qty) {
+        if (!pharmacy.issueMedicine(name, qty)) return false;
+        journalMedicine(name);
+        return true;
+    }
     DiagnosticsService& getDiagnostics() { return diagnostics; }
     EmergencyService& getEmergency() { return emergency; }
     SurgeryService& getSurgery() { return surgery; }
 
     // users
-    bool addUser(const User &u) { if (users.count(u.username)) return false; users[u.username] = u; return true; }
-    bool authenticate(const string &uname, const string &pwd, User &out) const {
-        auto it = users.find(uname); if (it == users.end()) return false;
-        if (it->second.password != pwd) return false;
-        out = it->second; return true;
+    bool addUser(const User &u) {
+        if (users.count(u.username)) return false;
+        users[u.username] = u;
+        record(TBL_USERS, 'U', u);
+        return true;
     }
+    // an empty Session if the username is unknown or the password is wrong
+    Session authenticate(const string &uname, const string &pwd) const {
+        uint32_t id = users.find(uname);
+        if (id == UserTable::NONE || users.at(id).password != pwd) return Session();
+        return Session{id};
+    }
+    const User& sessionUser(Session s) const { return users.at(s.user); }
 
     void listPatients() const {
      cout << "--- Patients ---\n";
-      for (auto &kv : patients) kv.second.displayInfo();
+      for (auto &kv : patients) { kv.second.displayInfo(); printHistory(kv.first, 0, 3); }
 	 }
 	 
 	 void printPatientsTable() const {
@@ -1025,7 +4318,7 @@ public:
              << setw(8) << left << p.getGender()
              << setw(18) << left << p.getContact()
              << setw(15) << left << (p.isInsured() ? "Yes" : "No")
-             << setw(18) << left << (p.isInsured() ? p.getInsuranceProvider() : "-") << "\n";
+             << setw(18) << left << (p.isInsured() ? string_view(p.getInsuranceProvider().str()) : string_view("-")) << "\n";
     }
 
     setColor(11);
@@ -1033,8 +4326,8 @@ public:
     setColor(7);
 }
 
-void printSinglePatientAsTable(int pid) {
-    Patient* p = findPatient(pid);
+void printSinglePatientAsTable(int pid) const {
+    const Patient* p = findPatient(pid);
     if (!p) {
         setColor(12); 
         cout << "Patient not found.\n"; 
@@ -1061,7 +4354,7 @@ void printSinglePatientAsTable(int pid) {
          << setw(8) << left << p->getGender()
          << setw(15) << left << p->getContact()
          << setw(10) << left << (p->isInsured() ? "Yes" : "No")
-         << setw(20) << left << (p->isInsured() ? p->getInsuranceProvider() : "-") 
+         << setw(20) << left << (p->isInsured() ? string_view(p->getInsuranceProvider().str()) : string_view("-")) 
          << "\n";
 
     setColor(11);
@@ -1071,7 +4364,8 @@ void printSinglePatientAsTable(int pid) {
 
 
 	 
-    void listDoctors() const { 
+    void listDoctors() { 
+    ensureAllAppointments(); // booked slots come from the appointments
     cout << "--- Doctors ---\n"; 
     for (auto &kv : doctors) kv.second.displayInfo();
      }
@@ -1140,11 +4434,13 @@ void printSinglePatientAsTable(int pid) {
 }
 
      
-    void listAppointments() const { 
+    void listAppointments() { 
+    ensureAllAppointments();
     cout << "--- Appointments ---\n";
-     for (auto &kv : appointments) cout << "Appointment ID: " << kv.second.id << "\nPatient ID: " << kv.second.patientId << "\nDoctor ID: " << kv.second.doctorId << "\nDate/time : " << kv.second.datetime << "\nInsured : " << kv.second.type << "\nReason: " << kv.second.reason << "\n"; }
+     for (auto &kv : appointments) cout << "Appointment ID: " << kv.second.id << "\nPatient ID: " << kv.second.patientId << "\nDoctor ID: " << kv.second.doctorId << "\nDate/time : " << kv.second.whenText() << "\nInsured : " << kv.second.type << "\nReason: " << kv.second.reason << "\n"; }
     
-    void printAppointmentsTable() const {
+    void printAppointmentsTable() {
+    ensureAllAppointments();
     setColor(11);
     cout << "\n====================== Appointments ======================\n";
     setColor(14);
@@ -1162,7 +4458,7 @@ void printSinglePatientAsTable(int pid) {
         cout << setw(5) << left << a.id
              << setw(8) << left << a.patientId
              << setw(8) << left << a.doctorId
-             << setw(20) << left << a.datetime
+             << setw(20) << left << a.whenText()
              << setw(12) << left << a.type
              << setw(25) << left << a.reason << "\n";
     }
@@ -1173,13 +4469,15 @@ void printSinglePatientAsTable(int pid) {
 }
 
     
-    void listBills() const {
+    void listBills() {
+     ensureAllBills();
      cout << "--- Bills ---\n";
       for (auto &kv : bills) {
 	kv.second.print(); cout << "\n"; } 
 	}
 	
-	void printBillsTable() const {
+	void printBillsTable() {
+    ensureAllBills();
     setColor(11);
     cout << "\n=================== Bills List ===================\n";
     setColor(14);
@@ -1203,19 +4501,49 @@ void printSinglePatientAsTable(int pid) {
 }
 
 
+    // -------- column-store reports --------
+    // "insured patients aged 20-30 per provider", by provider name
+    vector<pair<string, uint64_t>> insuredPatientsByProvider(int minAge, int maxAge) {
+        syncPatientEdits();
+        auto out = patientColumns.insuredByProvider(minAge, maxAge);
+        sort(out.begin(), out.end());
+        return out;
+    }
+    size_t patientsAgedBetween(int minAge, int maxAge) { syncPatientEdits(); return patientColumns.countAgedBetween(minAge, maxAge); }
+    vector<pair<string, uint64_t>> patientsByGender() { syncPatientEdits(); return patientColumns.countByGender(); }
+    // (doctor id, appointments in [from, to)), busiest first; the defaults
+    // also count appointments whose time did not parse
+    vector<pair<int, uint64_t>> appointmentsPerDoctor(Timestamp from = Timestamp(), Timestamp to = Timestamp(INT64_MAX)) {
+        ensureAllAppointments();
+        auto out = appointmentColumns.perDoctorBetween(from, to);
+        sort(out.begin(), out.end(), [](const pair<int, uint64_t> &a, const pair<int, uint64_t> &b) {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        });
+        return out;
+    }
+    size_t appointmentsBetween(Timestamp from, Timestamp to) { ensureAllAppointments(); return appointmentColumns.countBetween(from, to); }
+    // sums of bill totals (after insurance), exact to the paisa
+    Money totalRevenue() { ensureAllBills(); syncBillEdits(); return billColumns.revenue(); }
+    Money revenueForPatient(int pid) { ensureAllBills(); syncBillEdits(); return billColumns.revenueForPatient(pid); }
+
     void printStatistics() {
+        ensureAllAppointments();
+        ensureAllBills();
         cout << "\n--- Hospital Statistics ---\n";
         cout << "Total patients: " << patients.size() << "\n";
         cout << "Total doctors: " << doctors.size() << "\n";
         cout << "Total staff: " << staffs.size() << "\n";
         cout << "Total appointments: " << appointments.size() << "\n";
-        double revenue = 0; for (auto &kv : bills) revenue += kv.second.total();
-        cout << "Total revenue: " << fixed << setprecision(2) << revenue << "\n";
-        map<int,int> cnt;
-        for (auto &kv : appointments) cnt[kv.second.doctorId]++;
-        int best = -1, bestCnt = 0;
-        for (auto &kv : cnt) if (kv.second > bestCnt) { best = kv.first; bestCnt = kv.second; }
+        cout << "Total revenue: " << totalRevenue() << "\n";
+        auto perDoctor = appointmentsPerDoctor();
+        int best = perDoctor.empty() ? -1 : perDoctor[0].first;
+        uint64_t bestCnt = perDoctor.empty() ? 0 : perDoctor[0].second;
         if (best == -1) cout << "No bookings yet\n"; else cout << "Most booked doctor: " << (doctors.count(best) ? doctors[best].getName() : "Unknown") << " (" << bestCnt << " bookings)\n";
+        auto byProvider = insuredPatientsByProvider(0, INT_MAX);
+        if (!byProvider.empty()) {
+            cout << "Insured patients by provider:\n";
+            for (auto &kv : byProvider) cout << "  " << kv.first << ": " << kv.second << "\n";
+        }
         cout << "---------------------------\n";
     }
 };
@@ -1243,6 +4571,7 @@ void adminMenu(SHMSDatabase &db, const User &me) {
         setColor(10); cout << "8) "; setColor(7); cout << "View Statistics\n";
         setColor(10); cout << "9) "; setColor(7); cout << "Surgery service\n";
         setColor(10); cout <<"10) "; setColor(7); cout << "Save & Return\n";
+        setColor(10); cout <<"11) "; setColor(7); cout << "Find Duplicate Patients/Doctors\n";
         setColor(12); cout << "0) "; setColor(7); cout << "Exit Program\n";
 
         int choice = promptInt("Enter choice: ");
@@ -1311,6 +4640,7 @@ void adminMenu(SHMSDatabase &db, const User &me) {
 	  pauseConsole();
 	  }
         else if (choice == 8) { db.printStatistics();
+        db.printLoadTimings();
         pauseConsole();
 	  }
 	 else if (choice == 9) {
@@ -1329,8 +4659,26 @@ void adminMenu(SHMSDatabase &db, const User &me) {
             setColor(10); cout << "All data saved successfully.\n"; setColor(7);
             return;
         }
+        else if (choice == 11) {
+            system("cls");
+            auto patientPairs = db.duplicatePatients();
+            auto doctorPairs = db.duplicateDoctors();
+            setColor(14); cout << "Possible duplicates (keep ID <- duplicate ID, edits):\n"; setColor(7);
+            for (auto &c : patientPairs)
+                cout << "  Patient " << c.keepId << " <- " << c.duplicateId << "  " << db.findPatient(c.keepId)->getName()
+                     << " / " << db.findPatient(c.duplicateId)->getName() << "  (" << c.distance << ")\n";
+            for (auto &c : doctorPairs)
+                cout << "  Doctor  " << c.keepId << " <- " << c.duplicateId << "  " << db.findDoctor(c.keepId)->getName()
+                     << " / " << db.findDoctor(c.duplicateId)->getName() << "  (" << c.distance << ")\n";
+            if (patientPairs.empty() && doctorPairs.empty()) cout << "  none\n";
+            else {
+                db.writeMergeCandidates(patientPairs, doctorPairs);
+                setColor(10); cout << "Written to " << MERGE_CANDIDATES_FILE << " for review.\n"; setColor(7);
+            }
+            pauseConsole();
+        }
         else if(choice==0) {
-        	db.saveAll();
+        	db.shutdown();
         	setColor(10); cout << "All data saved. Exiting program.\n"; setColor(7);
             exit(0);
 	  }
@@ -1357,6 +4705,7 @@ void adminMenu(SHMSDatabase &db, const User &me) {
         setColor(10); cout << "6) "; setColor(7); cout << "Add Medicine to Pharmacy\n";
         setColor(10); cout << "7) "; setColor(7); cout << "Register Emergency Admission\n";
         setColor(10); cout << "8) "; setColor(7); cout << "Save & Return\n";
+        setColor(10); cout << "9) "; setColor(7); cout << "Find Patient by Phone / National ID\n";
         setColor(12); cout << "0) "; setColor(7); cout << "Exit program\n";
 
         int choice = promptInt("Enter choice: ");
@@ -1375,6 +4724,19 @@ void adminMenu(SHMSDatabase &db, const User &me) {
                 p.setInsuranceProvider(promptString("Insurance provider: "));
             }
             p.setNationalId(promptString("National ID (optional): ", true));
+
+            vector<int> dups = db.possibleDuplicates(p);
+            if (!dups.empty()) {
+                setColor(14); cout << "Already registered with the same national ID or contact:\n"; setColor(7);
+                for (int id : dups) {
+                    const Patient *d = db.findPatient(id);
+                    cout << "  ID " << id << "  " << d->getName() << "  " << d->getContact();
+                    if (!d->getNationalId().empty()) cout << "  " << d->getNationalId();
+                    cout << "\n";
+                }
+                string go = promptString("Register anyway? (y/n): ", true);
+                if (go.empty() || (go[0] != 'y' && go[0] != 'Y')) continue;
+            }
             int pid = db.addPatient(p);
 
             setColor(10);
@@ -1408,7 +4770,7 @@ void adminMenu(SHMSDatabase &db, const User &me) {
             string dt = date + " " + time;
             string type = promptString("Type (online/walk-in): ");
             string reason = promptString("Reason: ");
-            Appointment a; a.patientId = pid; a.doctorId = did; a.datetime = dt; a.type = type; a.reason = reason;
+            Appointment a; a.patientId = pid; a.doctorId = did; a.datetime = Timestamp::parse(dt); a.type = type; a.reason = reason;
             try {
                 int aid = db.scheduleAppointment(a);
                 setColor(10);
@@ -1431,7 +4793,7 @@ void adminMenu(SHMSDatabase &db, const User &me) {
         else if (choice == 5) {
         	system("cls");
             int pid = promptInt("Patient ID: ");
-            Patient* pp = db.findPatient(pid);
+            const Patient* pp = db.findPatient(pid);
             if (!pp) { setColor(12); cout << "Patient not found\n"; setColor(7); continue; }
             bool insured = pp->isInsured();
             double cov = insured ? promptDouble("Insurance coverage percent: ", 0.0) : 0.0;
@@ -1440,14 +4802,17 @@ void adminMenu(SHMSDatabase &db, const User &me) {
             setColor(10);
             cout << "Bill created with ID " << bid << ". Enter items (type 'done' for description to finish):\n";
             setColor(7);
+            cout << "Catalog:";
+            for (const char *code : BILL_CATALOG) cout << " " << code;
+            cout << " (or any description)\n";
 
             while (true) {
                 string desc = promptString("Item description: ", true);
                 if (trim(desc) == "done" || desc.empty()) break;
-                double amt = promptDouble("Amount: ");
+                Money amt = promptMoney("Amount: ");
                 db.addBillItem(bid, desc, amt);
             }
-            Bill* b = db.getBill(bid);
+            const Bill* b = db.getBill(bid);
             if (b) b->print();
             pauseConsole();
         }
@@ -1460,7 +4825,7 @@ void adminMenu(SHMSDatabase &db, const User &me) {
             string name = promptString("Medicine name: ");
             int qty = promptInt("Qty: ");
             string exp = promptString("Expiry (YYYY-MM-DD): ");
-            db.getPharmacy().addMedicine(name, qty, exp);
+            db.addMedicine(name, qty, exp);
             setColor(10);
             cout << "Medicine added.\n";
             setColor(7);
@@ -1488,9 +4853,21 @@ void adminMenu(SHMSDatabase &db, const User &me) {
             return;
         }
 
+        // 9) Find patient by phone or national ID
+        else if (choice == 9) {
+        	system("cls");
+            string key = promptString("Phone or National ID: ");
+            auto byPhone = db.patientsByPhone(key);
+            auto byNid = db.patientsByNationalId(key);
+            if (byPhone.empty() && byNid.empty()) { setColor(12); cout << "No patient found.\n"; setColor(7); }
+            for (auto &p : byPhone) { cout << "(phone match) "; p.displayInfo(); db.printHistory(p.getId(), 0, 3); }
+            for (auto &p : byNid) { cout << "(national ID match) "; p.displayInfo(); db.printHistory(p.getId(), 0, 3); }
+            pauseConsole();
+        }
+
         // 0) Exit program
         else if (choice == 0) {
-            db.saveAll();
+            db.shutdown();
             setColor(10); cout << "Saved. Exiting.\n"; setColor(7);
             exit(0);
         }
@@ -1536,7 +4913,7 @@ void patientMenu(SHMSDatabase &db, const User &me) {
 
 
         else if (choice == 2) {
-    auto ap = db.getAppointmentsForPatient(pid);
+    auto ap = db.appointmentsForPatient(pid);
     setColor(11);
     printSlow("\n=================== My Appointments ===================\n",3);
     setColor(14);
@@ -1554,7 +4931,7 @@ void patientMenu(SHMSDatabase &db, const User &me) {
         for (auto &a : ap) {
             cout << setw(5) << left << a.id
                  << setw(8) << left << a.doctorId
-                 << setw(20) << left << a.datetime
+                 << setw(20) << left << a.whenText()
                  << setw(15) << left << a.type
                  << setw(25) << left << a.reason << "\n";
         }
@@ -1567,7 +4944,7 @@ void patientMenu(SHMSDatabase &db, const User &me) {
 }
 
         else if (choice == 3) {
-            auto bills = db.getBillsForPatient(pid);
+            auto bills = db.billsForPatient(pid);
             setColor(11); cout << "\n=== My Bills ===\n"; setColor(7);
             if (bills.empty()) cout << "No bills found.\n";
             else for (auto &b : bills) b.print();
@@ -1583,7 +4960,7 @@ void patientMenu(SHMSDatabase &db, const User &me) {
             return;
         }
         else if (choice == 0) {
-            db.saveAll();
+            db.shutdown();
             setColor(10); cout << "Saved. Exiting.\n"; setColor(7);
             exit(0);
         }
@@ -1617,20 +4994,22 @@ void doctorMenu(SHMSDatabase &db, const User &me) {
         setColor(10); cout << "2) "; setColor(7); cout << "Add Diagnostic Report for Patient\n";
         setColor(10); cout << "3) "; setColor(7); cout << "Schedule Surgery for Patient\n";
         setColor(10); cout << "4) "; setColor(7); cout << "Save & Return\n";
+        setColor(10); cout << "5) "; setColor(7); cout << "Add Medical History Entry\n";
+        setColor(10); cout << "6) "; setColor(7); cout << "View Patient Medical History\n";
         setColor(12); cout << "0) "; setColor(7); cout << "Exit Program\n";
 
         int choice = promptInt("Enter choice: ");
 
         if (choice == 1) {
             // Appointments Table for this doctor
-            auto ap = db.getAppointmentsForDoctor(did);
+            auto ap = db.appointmentsForDoctor(did);
             setColor(11);
             cout << "\n=== My Appointments ===\n"; setColor(7);
             if (ap.empty()) cout << "No appointments found.\n";
             else {
                 cout << setw(5) << "AID" << setw(8) << "PID" << setw(20) << "Date/Time" << setw(15) << "Type" << setw(25) << "Reason\n";
                 for (auto &a : ap)
-                    cout << setw(5) << a.id << setw(8) << a.patientId << setw(20) << a.datetime << setw(15) << a.type << setw(25) << a.reason << "\n";
+                    cout << setw(5) << a.id << setw(8) << a.patientId << setw(20) << a.whenText() << setw(15) << a.type << setw(25) << a.reason << "\n";
             }
             pauseConsole();
         }
@@ -1652,8 +5031,31 @@ void doctorMenu(SHMSDatabase &db, const User &me) {
             setColor(10); cout << "Saved. Returning.\n"; setColor(7);
             return;
         }
+        else if (choice == 5) {
+            int pid = promptInt("Patient ID: ");
+            string entry = promptString("History entry: ");
+            if (db.addHistory(pid, entry)) { setColor(10); cout << "History entry added.\n"; setColor(7); }
+            else { setColor(12); cout << "Patient not found or entry empty.\n"; setColor(7); }
+            pauseConsole();
+        }
+        else if (choice == 6) {
+            int pid = promptInt("Patient ID: ");
+            const Patient *p = db.findPatient(pid);
+            if (!p) { setColor(12); cout << "Patient not found.\n"; setColor(7); pauseConsole(); continue; }
+            // ten entries a page, newest first
+            for (size_t page = 0; ; ++page) {
+                system("cls");
+                p->displayInfo();
+                if (db.historyCount(pid) == 0) { cout << "  No medical history.\n"; break; }
+                db.printHistory(pid, page);
+                if ((page + 1) * 10 >= db.historyCount(pid)) break;
+                string more = promptString("Show older entries? (y/n): ", true);
+                if (more.empty() || (more[0] != 'y' && more[0] != 'Y')) break;
+            }
+            pauseConsole();
+        }
         else if (choice == 0) {
-            db.saveAll();
+            db.shutdown();
             setColor(10); cout << "Saved. Exiting.\n"; setColor(7);
             exit(0);
         }
@@ -1713,13 +5115,12 @@ void guestViewMenu(SHMSDatabase &db) {
             pauseConsole();
         }
         else if (choice == 6) {
-            // Back to main menu
-            db.saveAll();
+            // Back to main menu (read-only menu, nothing to save)
             setColor(10); cout << "Returning to Main Menu.\n"; setColor(7);
             break;
         }
         else if (choice == 0) {
-            db.saveAll();
+            db.shutdown();
             setColor(10); cout << "Saved. Exiting.\n"; setColor(7);
             exit(0);
         }
@@ -1734,6 +5135,7 @@ void guestViewMenu(SHMSDatabase &db) {
 
 // ======================================================((     Main loop   ))===========================================================
 
+#ifndef SHMS_NO_MAIN // Benchmark.cpp includes this file for its classes
 int main() {
     ios::sync_with_stdio(false);
     cin.tie(nullptr);
@@ -1794,8 +5196,9 @@ while (true) {
     string uname = promptString("Username: ");
     string pwd = promptString("Password: ");
 
-    User u;
-    if (db.authenticate(uname, pwd, u) && u.role == expectedRole) {
+    Session session = db.authenticate(uname, pwd);
+    if (session && db.sessionUser(session).role == expectedRole) {
+        const User &u = db.sessionUser(session);
         setColor(10); printSlow("Login successful as " + expectedRole, 30); setColor(7);
 
         if (expectedRole == "Admin") adminMenu(db, u);
@@ -1836,6 +5239,14 @@ while (true) {
                 p.setInsuranceProvider(promptString("Insurance provider: ")); 
             }
 
+            if (!db.findPatientsByPhone(contact).empty()) {
+                setColor(14);
+                printSlow("This contact number is already registered. If you have been here before, ask the front desk for your patient ID.", 30);
+                setColor(7);
+                string go = promptString("Register a new record anyway? (y/n): ", true);
+                if (go.empty() || (go[0] != 'y' && go[0] != 'Y')) continue;
+            }
+
             int pid = db.addPatient(p);
             setColor(10);
             printSlow("Patient registered with ID " + to_string(pid) + ". Create login now.", 30);
@@ -1871,6 +5282,7 @@ while (true) {
  return 0;
  
  }
+#endif
 
 
 
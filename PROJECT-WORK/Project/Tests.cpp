@@ -0,0 +1,191 @@
+// Regression checks for the Smart Hospital Management System.
+// Build:  g++ -std=c++17 -pthread Tests.cpp -o Tests
+// Run:    Tests   (in an empty scratch directory: it writes the data files there;
+//         exits non-zero if a check fails)
+#define SHMS_NO_MAIN
+#include "Project Code.cpp"
+
+static int failures = 0;
+
+static void check(bool ok, const string &what) {
+    if (!ok) ++failures;
+    cout << (ok ? "  ok    " : "  FAIL  ") << what << "\n";
+}
+
+static string readFile(const string &fname) {
+    ifstream in(fname, ios::binary);
+    return string((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+}
+
+static bool fileExists(const string &fname) {
+    return ifstream(fname).good();
+}
+
+static void writeFile(const string &fname, const string &text) {
+    ofstream out(fname, ios::binary | ios::trunc);
+    out << text;
+}
+
+static void removeDataFiles() {
+    for (auto &f : {USERS_FILE, PATIENTS_FILE, DOCTORS_FILE, STAFF_FILE, APPOINTMENTS_FILE, BILLS_FILE,
+                    MEDICINES_FILE, HISTORY_FILE, JOURNAL_FILE, SNAPSHOT_FILE})
+        remove(f.c_str());
+}
+
+// --------------------------
+// Timestamps
+// --------------------------
+static void testTimestampParse() {
+    cout << "Timestamp::parse\n";
+    check(Timestamp::parse("2025-09-01 09:00").str(false) == "2025-09-01 09:00", "padded date and time");
+    check(Timestamp::parse("2025-9-1 9:00").str(false) == "2025-09-01 09:00", "one-digit month, day and hour");
+    check(Timestamp::parse("2025-09-01T09:00:30").str() == "2025-09-01 09:00:30", "'T' separator with seconds");
+    check(!Timestamp::parse("tomorrow 10am").valid(), "free text is not a time");
+    check(!Timestamp::parse("2025-02-30 10:00").valid(), "day past the end of the month");
+    check(!Timestamp::parse("2025-09-01 9:5").valid(), "one-digit minute");
+    check(!Timestamp::parse("2025-09-01").valid(), "date without a time");
+}
+
+// Rows typed by hand before timestamps were parsed must come back out of a
+// table rewrite (journal compaction) with their date text intact.
+static void testLegacyTimestampsSurviveCompaction() {
+    cout << "Legacy timestamps through compaction\n";
+    removeDataFiles();
+    writeFile(PATIENTS_FILE, "3,\"Muneeba Arshad\",22,F,+92-300-2222222,0,,,\n4,\"Ali Hassan\",30,M,+92-300-3333333,1,DemoCare,,\n");
+    writeFile(APPOINTMENTS_FILE,
+              "4,3,1,\"2025-9-1 9:00\",online,legacy\n"
+              "5,4,1,tomorrow 10am,walk-in,typed\n"
+              "6,4,1,\"2025-09-02 10:00\",walk-in,cancel me\n");
+    writeFile(BILLS_FILE, "7,3,0,0.000000,last monday,\"Consultation#100\"\n");
+
+    for (int round = 0; round < 2; ++round) { // the second round starts from shms.snap
+        {
+            SHMSDatabase db(false);
+            if (round == 0) db.cancelAppointment(6);
+            db.createBill(4, false, 0);
+            db.compact();
+            check(db.flush(), "compaction wrote the files");
+        }
+        string appts = readFile(APPOINTMENTS_FILE), bills = readFile(BILLS_FILE);
+        string tag = round == 0 ? " (from CSV)" : " (from snapshot)";
+        check(appts.find("4,3,1,\"2025-09-01 09:00\",online,legacy") != string::npos, "one-digit date is kept" + tag);
+        check(appts.find("5,4,1,\"tomorrow 10am\",walk-in,typed") != string::npos, "free-text date is kept" + tag);
+        check(appts.find("6,4,1") == string::npos, "cancelled row is gone" + tag);
+        check(bills.find("7,3,0,0.000000,\"last monday\",") != string::npos, "free-text bill date is kept" + tag);
+    }
+    removeDataFiles();
+}
+
+// --------------------------
+// Lazy history tables
+// --------------------------
+// A lazy session leaves appointments and bills out of shms.snap; an eager
+// session that then loads them from CSV must not reuse their ids.
+static void testIdsAfterLazySnapshot() {
+    cout << "Ids after a lazy session's snapshot\n";
+    removeDataFiles();
+    { SHMSDatabase db(false); } // seeds doctors 1-2 and patients 3-4
+    writeFile(APPOINTMENTS_FILE,
+              "1,3,1,\"2025-09-10 10:30\",online,first\n"
+              "2,4,1,\"2025-09-10 11:00\",online,second\n"
+              "7,4,2,\"2025-09-11 09:00\",walk-in,third\n");
+    writeFile(BILLS_FILE, "1,3,0,0.000000,\"2025-09-10 10:30:00\",Consultation#100\n5,4,0,0.000000,\"2025-09-10 11:00:00\",MRI#200\n");
+    { SHMSDatabase db(true); } // never touches the lazy tables
+    check(fileExists(SNAPSHOT_FILE), "the lazy session wrote a snapshot");
+
+    {
+        SHMSDatabase db(false);
+        Appointment a; a.patientId = 3; a.doctorId = 2; a.datetime = Timestamp::parse("2025-09-12 10:00"); a.type = "online"; a.reason = "new";
+        int aid = db.scheduleAppointment(a);
+        check(aid == 8, "new appointment id follows the file (got " + to_string(aid) + ")");
+        check(db.getAppointmentsForPatient(3).size() == 2, "appointment 1 is not overwritten");
+        int bid = db.createBill(3, false, 0);
+        check(bid == 6, "new bill id follows the file (got " + to_string(bid) + ")");
+    }
+    removeDataFiles();
+}
+
+static string billIds(const vector<Bill> &bills) {
+    string out;
+    for (auto &b : bills) out += (out.empty() ? "" : ",") + to_string(b.billId);
+    return out;
+}
+
+// billsForPatient goes through the per-patient index in both modes
+static void testBillsForPatient() {
+    cout << "Bills for one patient\n";
+    for (bool lazy : {true, false}) {
+        removeDataFiles();
+        { SHMSDatabase db(false); } // seeds patients 3-4
+        writeFile(BILLS_FILE,
+                  "1,3,0,0.000000,\"2025-09-10 10:30:00\",Consultation#100\n"
+                  "2,4,0,0.000000,\"2025-09-10 11:00:00\",MRI#200\n"
+                  "5,3,0,0.000000,\"2025-09-11 09:00:00\",X-ray#300\n");
+        string mode = lazy ? " (lazy)" : " (eager)";
+        SHMSDatabase db(lazy);
+        check(billIds(db.getBillsForPatient(3)) == "1,5", "file bills of patient 3" + mode);
+        int added = db.createBill(3, false, 0);
+        check(billIds(db.getBillsForPatient(3)) == "1,5," + to_string(added), "a new bill is listed" + mode);
+        db.editBill(5)->patientId = 4;
+        check(billIds(db.getBillsForPatient(3)) == "1," + to_string(added), "an edited bill leaves its old patient" + mode);
+        check(billIds(db.getBillsForPatient(4)) == "2,5", "and joins the new one" + mode);
+        check(db.getBillsForPatient(99).empty(), "no bills for an unknown patient" + mode);
+    }
+    removeDataFiles();
+}
+
+// --------------------------
+// Snapshot
+// --------------------------
+// A same-size edit to a CSV file right after a save must make the snapshot
+// stale, even within the same second.
+static void testSameSizeEditInvalidatesSnapshot() {
+    cout << "Same-size CSV edit after a save\n";
+    removeDataFiles();
+    writeFile(PATIENTS_FILE, "3,\"Muneeba Arshad\",22,F,+92-300-2222222,0,,,\n");
+    { SHMSDatabase db(false); db.createBill(3, false, 0); } // writes the files and shms.snap
+    this_thread::sleep_for(chrono::milliseconds(20)); // past the file system's timestamp granularity
+    string text = readFile(PATIENTS_FILE);
+    size_t age = text.find(",22,");
+    check(age != string::npos, "saved row found");
+    if (age != string::npos) text.replace(age, 4, ",23,");
+    writeFile(PATIENTS_FILE, text);
+    {
+        SHMSDatabase db(false);
+        const Patient *p = db.findPatient(3);
+        check(p && p->getAge() == 23, "the edited CSV wins over the snapshot");
+    }
+    removeDataFiles();
+}
+
+// --------------------------
+// Printing
+// --------------------------
+// listings are read-only: they must not intern display placeholders
+static void testPrintingInternsNothing() {
+    cout << "Patient tables leave the symbol table alone\n";
+    removeDataFiles();
+    SHMSDatabase db(false); // seeds uninsured patients
+    ostringstream sink;
+    streambuf *saved = cout.rdbuf(sink.rdbuf());
+    size_t before = SymbolTable::global().size();
+    db.printPatientsTable();
+    db.printSinglePatientAsTable(3);
+    size_t after = SymbolTable::global().size();
+    cout.rdbuf(saved);
+    check(sink.str().find(" -") != string::npos, "uninsured patients show '-'");
+    check(after == before, "no symbol interned while printing");
+    db.shutdown();
+    removeDataFiles();
+}
+
+int main() {
+    testTimestampParse();
+    testLegacyTimestampsSurviveCompaction();
+    testIdsAfterLazySnapshot();
+    testBillsForPatient();
+    testSameSizeEditInvalidatesSnapshot();
+    testPrintingInternsNothing();
+    cout << (failures ? "FAILED: " + to_string(failures) + " check(s)\n" : "All checks passed\n");
+    return failures ? 1 : 0;
+}